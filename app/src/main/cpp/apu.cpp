@@ -1,6 +1,8 @@
 #include "apu.h"
 #include "cpu.h"
+#include <algorithm>
 #include <cmath>
+#include <climits>
 
 const uint8_t SquareChannel::DUTIES[4][8] = {
     {0, 1, 0, 0, 0, 0, 0, 0}, // 12.5%
@@ -23,23 +25,73 @@ const uint16_t NoiseChannel::PERIOD_TABLE[16] = {
     4, 8, 16, 32, 64, 96, 128, 160, 202, 254, 380, 508, 762, 1016, 2034, 4068
 };
 
+uint16_t NoiseChannel::JUMPS[2][32][15];
 
+void NoiseChannel::buildJumps() {
+    static bool built = false;
+    if (built) return;
+    NoiseChannel probe;
+    for (int m = 0; m < 2; m++) {
+        probe.mode = m;
+        for (int c = 0; c < 15; c++) {
+            probe.shiftRegister = 1 << c;
+            JUMPS[m][0][c] = probe.shift();
+        }
+        // Two 2^i-step jumps make a 2^(i+1)-step one
+        for (int i = 1; i < 32; i++) {
+            for (int c = 0; c < 15; c++) {
+                uint16_t half = JUMPS[m][i - 1][c];
+                uint16_t next = 0;
+                for (int b = 0; b < 15; b++) {
+                    if (half & (1 << b)) next ^= JUMPS[m][i - 1][b];
+                }
+                JUMPS[m][i][c] = next;
+            }
+        }
+    }
+    built = true;
+}
+
+
+
+int32_t APU::PULSE_TABLE[31];
+int32_t APU::TND_TABLE[203];
+
+void APU::buildMixerTables() {
+    static bool built = false;
+    if (built) return;
+    PULSE_TABLE[0] = 0;
+    for (int n = 1; n < 31; n++) PULSE_TABLE[n] = (int32_t)lround(95.52 / (8128.0 / n + 100) * LEVEL_ONE);
+    TND_TABLE[0] = 0;
+    for (int n = 1; n < 203; n++) TND_TABLE[n] = (int32_t)lround(163.67 / (24329.0 / n + 100) * LEVEL_ONE);
+    built = true;
+}
 
 void APU::reset() {
+    NoiseChannel::buildJumps();
+    buildMixerTables();
     square1 = {};
     square2 = {};
     triangle = {};
     noise = {};
     dmc = {};
     
-    accumulatedCycles = 0;
+    blip.setRates(CPU_FREQ, INTERNAL_RATE);
+    blip.clear();
+    blipTime = 0;
+    apuClock = false;
+    channelOutputs = 0;
+    level = 0;
     totalSamplesGenerated = 0;
-    filterAccumulator = 128.0f;
+    filters.setRate(INTERNAL_RATE);
+    filters.reset();
+    resampler.setRates(INTERNAL_RATE, outputRate);
+    resampler.reset();
     
     frameStep = 0;
     frameCounterMode = false;
     frameIRQDisable = false;
-    if (cpu) cpu->irqPending = false;
+    if (cpu) cpu->setIrq(CPU::IRQ_FRAME_COUNTER, false);
 }
 
 void APU::write(uint16_t addr, uint8_t val) {
@@ -154,114 +206,173 @@ void APU::write(uint16_t addr, uint8_t val) {
                 clockQuarterFrame();
                 clockHalfFrame();
             }
+            catchUp(syncedCycle); // Reposts the frame IRQ for the new mode
             break;
     }
+    updateLevel();
 }
 
+// The APU runs from one cycle something can change on to the next: a frame counter
+// step, or the timer expiry of a channel that is audible. Everything in between
+// (including every timer of a silent channel) is advanced in bulk.
 void APU::step(int cycles) {
-    for (int i = 0; i < cycles; i++) {
-        // Frame Counter
-        frameCounterCycles++;
-        
-        if (!frameCounterMode) {
-            // 4-step mode (Approx 60Hz)
-            switch (frameCounterCycles) {
-                case 3729:
-                    clockQuarterFrame();
-                    break;
-                case 7457:
-                    clockQuarterFrame();
-                    clockHalfFrame();
-                    break;
-                case 11186:
-                    clockQuarterFrame();
-                    break;
-                case 14915:
-                    clockQuarterFrame();
-                    clockHalfFrame();
-                    if (!frameIRQDisable && cpu) cpu->irqPending = true;
-                    frameCounterCycles = 0;
-                    break;
-            }
-        } else {
-            // 5-step mode (Approx 48Hz)
-            switch (frameCounterCycles) {
-                case 3729:
-                    clockQuarterFrame();
-                    break;
-                case 7457:
-                    clockQuarterFrame();
-                    clockHalfFrame();
-                    break;
-                case 11186:
-                    clockQuarterFrame();
-                    break;
-                case 18641:
-                    clockQuarterFrame();
-                    clockHalfFrame();
-                    frameCounterCycles = 0;
-                    break;
-            }
+    while (cycles > 0) {
+        uint32_t untilStep = clocksUntilFrameStep();
+        uint32_t n = std::min((uint32_t)cycles, untilStep);
+        n = std::min(n, MAX_BLOCK_CLOCKS - blipTime);
+        uint32_t firstClock = apuClock ? 1 : 0; // Cycle of the next pulse/noise clock
+        if (square1.audible()) n = std::min(n, firstClock + 2 * square1.timerValue + 1);
+        if (square2.audible()) n = std::min(n, firstClock + 2 * square2.timerValue + 1);
+        if (noise.audible()) n = std::min(n, firstClock + 2 * noise.timerValue + 1);
+        if (triangle.audible()) n = std::min(n, triangle.timerValue + 1u);
+
+        // The cycles before the last one, then the last one as the hardware orders it:
+        // the frame counter first, the timers next, then the mix
+        clockTimers(n - 1);
+        blipTime += n - 1;
+        frameCounterCycles += n;
+        if (n == untilStep) clockFrameCounter();
+        if (clockTimers(1)) updateLevel();
+        cycles -= n;
+        if (++blipTime == MAX_BLOCK_CLOCKS) endFrame(); // Nobody is ending blocks (benchmark)
+    }
+}
+
+bool APU::clockTimers(uint32_t cycles) {
+    if (cycles == 0) return false;
+    // Triangle clocks every CPU cycle
+    bool moved = triangle.clockTimer(cycles);
+
+    // Pulse and Noise clock every 2 CPU cycles
+    uint32_t clocks = apuClock ? cycles / 2 : (cycles + 1) / 2;
+    apuClock ^= cycles & 1;
+    return square1.clockTimer(clocks) | square2.clockTimer(clocks) | noise.clockTimer(clocks) | moved;
+}
+
+uint32_t APU::clocksUntilFrameStep() const {
+    uint32_t next = frameCounterMode ? 18641 : FRAME_COUNTER_RATE;
+    if (frameCounterCycles < 3729) next = 3729;
+    else if (frameCounterCycles < 7457) next = 7457;
+    else if (frameCounterCycles < 11186) next = 11186;
+    return next - frameCounterCycles;
+}
+
+void APU::clockFrameCounter() {
+    if (!frameCounterMode) {
+        // 4-step mode (Approx 60Hz)
+        switch (frameCounterCycles) {
+            case 3729:
+                clockQuarterFrame();
+                break;
+            case 7457:
+                clockQuarterFrame();
+                clockHalfFrame();
+                break;
+            case 11186:
+                clockQuarterFrame();
+                break;
+            case 14915:
+                clockQuarterFrame();
+                clockHalfFrame();
+                if (!frameIRQDisable && cpu) cpu->setIrq(CPU::IRQ_FRAME_COUNTER, true);
+                frameCounterCycles = 0;
+                break;
         }
-        
-        // Triangle clocks every CPU cycle
-        triangle.clockTimer();
-
-        // Pulse and Noise clock every 2 CPU cycles
-        static bool apuClock = false;
-        apuClock = !apuClock;
-        if (apuClock) {
-            square1.clockTimer();
-            square2.clockTimer();
-            noise.clockTimer();
+    } else {
+        // 5-step mode (Approx 48Hz)
+        switch (frameCounterCycles) {
+            case 3729:
+                clockQuarterFrame();
+                break;
+            case 7457:
+                clockQuarterFrame();
+                clockHalfFrame();
+                break;
+            case 11186:
+                clockQuarterFrame();
+                break;
+            case 18641:
+                clockQuarterFrame();
+                clockHalfFrame();
+                frameCounterCycles = 0;
+                break;
         }
-        
-        // Sample generation
-        accumulatedCycles += 1.0;
-        if (accumulatedCycles >= CYCLES_PER_SAMPLE) {
-            float pulse1 = square1.getOutput();
-            float pulse2 = square2.getOutput();
-            float tri = triangle.getOutput();
-            float nse = noise.getOutput();
-            float _dmc = dmc.getOutput();
-            
-            // NES Mixer (Non-linear)
-            float pulse_out = 0;
-            if (pulse1 + pulse2 > 0) {
-                pulse_out = 95.88f / ((8128.0f / (pulse1 + pulse2)) + 100.0f);
-            }
-            
-            float tnd_out = 0;
-            float tnd_divisor = (tri / 8227.0f) + (nse / 12241.0f) + (_dmc / 22638.0f);
-            if (tnd_divisor > 0) {
-                tnd_out = 159.79f / ((1.0f / tnd_divisor) + 100.0f);
-            }
-            
-            float output = pulse_out + tnd_out;
-            
-            // Convert to 0-255 range (output is roughly 0.0 to 1.0, but scaling for volume)
-            float targetSample = 128.0f + (output * 600.0f); 
-            
-            // Hardening: Clamp and sanitize
-            if (targetSample > 255.0f) targetSample = 255.0f;
-            else if (targetSample < 0.0f) targetSample = 0.0f;
-            else if (!(targetSample >= 0.0f && targetSample <= 255.0f)) targetSample = 128.0f; // NaN protection
-            
-            // Low-Pass Filter
-            filterAccumulator = filterAccumulator + 0.25f * (targetSample - filterAccumulator);
-            ringBuffer.write((uint8_t)filterAccumulator);
-            
-            accumulatedCycles -= CYCLES_PER_SAMPLE;
-            totalSamplesGenerated++;
+    }
+}
+
+void APU::updateLevel() {
+    uint8_t pulse1 = square1.getOutput();
+    uint8_t pulse2 = square2.getOutput();
+    uint8_t tri = triangle.getOutput();
+    uint8_t nse = noise.getOutput();
+    uint8_t _dmc = dmc.getOutput();
+    uint64_t outputs = pulse1 | (pulse2 << 8) | (tri << 16) | ((uint64_t)nse << 24) | ((uint64_t)_dmc << 32);
+    if (outputs == channelOutputs) return;
+    channelOutputs = outputs;
+
+    // NES Mixer (Non-linear): both groups are functions of a channel sum, so tabulated
+    int32_t mixed = PULSE_TABLE[pulse1 + pulse2] + TND_TABLE[3 * tri + 2 * nse + _dmc];
+    if (mixed != level) {
+        blip.addDelta(blipTime, mixed - level);
+        level = mixed;
+    }
+}
+
+void APU::endFrame() {
+    blip.endFrame(blipTime);
+    blipTime = 0;
+
+    int32_t levels[BlipBuffer::MAX_SAMPLES];
+    float samples[BlipBuffer::MAX_SAMPLES];
+    int count = blip.readSamples(levels, BlipBuffer::MAX_SAMPLES);
+    for (int i = 0; i < count; i++) samples[i] = levels[i] * (1.0f / LEVEL_ONE);
+    filterBlock(filters, samples, count);
+
+    // Drift control: the emulator and the audio device run off different clocks, so
+    // run slightly fast while the ring buffer is below half full, slightly slow above
+    double error = (AudioRingBuffer::SIZE / 2 - ringBuffer.getLevel()) / (double)AudioRingBuffer::SIZE;
+    double drift = error * DRIFT_GAIN;
+    if (drift > MAX_DRIFT) drift = MAX_DRIFT;
+    else if (drift < -MAX_DRIFT) drift = -MAX_DRIFT;
+    resampler.setAdjust(1.0 + drift);
+    resampler.write(samples, count);
+
+    while ((count = resampler.read(samples, BlipBuffer::MAX_SAMPLES)) > 0) {
+        for (int i = 0; i < count; i++) {
+            // Centered on 0 (the high-pass removed the DC), scaled for volume
+            float targetSample = samples[i] * OUTPUT_GAIN;
+            if (targetSample > 32767.0f) targetSample = 32767.0f;
+            else if (targetSample < -32768.0f) targetSample = -32768.0f;
+            ringBuffer.write((int16_t)lrintf(targetSample));
         }
+        totalSamplesGenerated += count;
     }
 }
 
+void APU::setOutputRate(double rate) {
+    outputRate = rate;
+    resampler.setRates(INTERNAL_RATE, rate);
+}
+
+void APU::catchUp(uint64_t cpuCycle) {
+    if (cpuCycle > syncedCycle) step((int)(cpuCycle - syncedCycle));
+    syncedCycle = cpuCycle;
+    if (!scheduler) return;
+    int clocks = clocksUntilFrameIrq();
+    scheduler->schedule(Event::FrameIrq, clocks == INT_MAX ? Scheduler::NEVER : syncedCycle + clocks);
+}
+
+int APU::clocksUntilFrameIrq() const {
+    if (frameCounterMode || frameIRQDisable) return INT_MAX;
+    return frameCounterCycles < FRAME_COUNTER_RATE ? (int)(FRAME_COUNTER_RATE - frameCounterCycles) : 1;
+}
+
 void APU::clockQuarterFrame() {
     square1.clockEnvelope();
     square2.clockEnvelope();
     triangle.clockLinear();
     noise.clockEnvelope();
+    updateLevel();
 }
 
 void APU::clockHalfFrame() {
@@ -271,6 +382,7 @@ void APU::clockHalfFrame() {
     square2.clockSweep(false);
     triangle.clockLength();
     noise.clockLength();
+    updateLevel();
 }
 
 uint8_t APU::readStatus() {
@@ -280,8 +392,8 @@ uint8_t APU::readStatus() {
     if (triangle.lengthCounter > 0) res |= 0x04;
     if (noise.lengthCounter > 0) res |= 0x08;
     
-    if (cpu && cpu->irqPending) res |= 0x40;
-    if (cpu) cpu->irqPending = false;
+    if (cpu && (cpu->irqLines & CPU::IRQ_FRAME_COUNTER)) res |= 0x40;
+    if (cpu) cpu->setIrq(CPU::IRQ_FRAME_COUNTER, false);
     
     return res;
 }
@@ -1,60 +1,89 @@
 /* 
  * APU (Audio Processing Unit) Module
  * Responsibility: Sound synthesis, Frame Counter timing, and Mixer.
+ * Output is band-limited (blip_buffer.h): the mix is only evaluated when a channel's
+ * output changes, and samples are produced a frame at a time, then run through the
+ * console's output filters (audio_filter.h) at a fixed internal rate, and finally
+ * resampled to the device's rate (resampler.h) as 16-bit PCM.
  * Supported: 2 Pulse channels, 1 Triangle, 1 Noise. (DMC is placeholder).
  */
 
 #ifndef APU_H
 #define APU_H
 
+#include <atomic>
 #include <cstdint>
 #include <cstring>
+#include "scheduler.h"
+#include "blip_buffer.h"
+#include "audio_filter.h"
+#include "resampler.h"
 
+// Single producer (the emulation thread, write) and single consumer (the audio
+// thread, read): `tail` is only stored by write() and `head` only by read(), each
+// published with release and observed with acquire. One slot stays empty.
 class AudioRingBuffer {
 public:
     static const int SIZE = 2048; // Smaller buffer for lower latency
-    uint8_t buffer[SIZE];
-    int head = 0; 
-    int tail = 0; 
+    int16_t buffer[SIZE];
+    std::atomic<int> head{0};
+    std::atomic<int> tail{0};
+    uint32_t overflows = 0; // Producer's: samples dropped because the buffer was full
 
     AudioRingBuffer() {
-        memset(buffer, 128, SIZE); // Initialize with silent DC (128)
+        memset(buffer, 0, sizeof(buffer)); // Initialize with silence
     }
 
-    void write(uint8_t sample) {
-        buffer[tail] = sample;
-        tail = (tail + 1) % SIZE;
-        if (tail == head) {
-             // Buffer overflow: push head forward to keep most recent audio (drop samples)
-             head = (head + 1) % SIZE;
+    void write(int16_t sample) {
+        int t = tail.load(std::memory_order_relaxed);
+        int next = (t + 1) % SIZE;
+        if (next == head.load(std::memory_order_acquire)) {
+            // Full: the new sample is dropped, the consumer's position is its own
+            overflows++;
+            return;
         }
+        buffer[t] = sample;
+        tail.store(next, std::memory_order_release);
     }
 
-    int read(uint8_t* out, int maxCount) {
+    // The level is held near half full by the APU's drift control (APU::endFrame)
+    int read(int16_t* out, int maxCount) {
+        int h = head.load(std::memory_order_relaxed);
+        const int t = tail.load(std::memory_order_acquire);
         int count = 0;
-        int level = getLevel();
-        
-        // If buffer is too deep (> 70%), skip some samples to catch up (Sync/Lag fix)
-        if (level > (SIZE * 0.7)) {
-            head = (tail - (int)(SIZE * 0.3) + SIZE) % SIZE;
-        }
-
-        while (count < maxCount && head != tail) {
-            out[count++] = buffer[head];
-            head = (head + 1) % SIZE;
+        while (count < maxCount && h != t) {
+            out[count++] = buffer[h];
+            h = (h + 1) % SIZE;
         }
+        head.store(h, std::memory_order_release);
         return count;
     }
 
-    int getLevel() {
-        return (tail >= head) ? (tail - head) : (SIZE - (head - tail));
+    // Exact on either side's own thread, a snapshot on any other
+    int getLevel() const {
+        int h = head.load(std::memory_order_acquire);
+        int t = tail.load(std::memory_order_acquire);
+        return (t >= h) ? (t - h) : (SIZE - (h - t));
     }
 
-    int getLevelPct() {
+    int getLevelPct() const {
         return (getLevel() * 100) / SIZE;
     }
 };
 
+// A divider counting down from `value` that reloads from `period` after reaching 0 -
+// clocked `clocks` times at once. Returns how many times it reloaded.
+inline uint32_t clockDivider(uint16_t& value, uint16_t period, uint32_t clocks) {
+    if (clocks <= value) {
+        value -= clocks;
+        return 0;
+    }
+    clocks -= value + 1u;
+    uint32_t span = period + 1u;
+    value = period - clocks % span;
+    return 1 + clocks / span;
+}
+
 struct SquareChannel {
     // 11-bit timer
     uint16_t timerPeriod = 0;
@@ -88,13 +117,15 @@ struct SquareChannel {
 
     static const uint8_t DUTIES[4][8];
 
-    void clockTimer() {
-        if (timerValue == 0) {
-            timerValue = timerPeriod;
-            dutyPos = (dutyPos + 1) & 7;
-        } else {
-            timerValue--;
-        }
+    bool clockTimer(uint32_t clocks) { // True when the sequencer moved
+        uint32_t moves = clockDivider(timerValue, timerPeriod, clocks);
+        dutyPos = (dutyPos + moves) & 7;
+        return moves != 0;
+    }
+
+    // Whether the sequencer moving can change the output
+    bool audible() const {
+        return enabled && lengthCounter > 0 && !isMuted() && (constantVolume ? constantVolumeValue : envelopeVolume) > 0;
     }
     
     void clockEnvelope() {
@@ -139,7 +170,7 @@ struct SquareChannel {
         }
     }
     
-    bool isMuted() {
+    bool isMuted() const {
         return timerPeriod < 8 || timerPeriod > 0x7FF;
     }
 
@@ -164,17 +195,15 @@ struct TriangleChannel {
 
     static const uint8_t TRIANGLE_STEPS[32];
 
-    void clockTimer() {
-        if (enabled && timerPeriod >= 2) {
-            if (timerValue == 0) {
-                timerValue = timerPeriod;
-                if (lengthCounter > 0 && linearCounter > 0) {
-                    step = (step + 1) & 0x1F;
-                }
-            } else {
-                timerValue--;
-            }
-        }
+    bool running() const { return enabled && timerPeriod >= 2; }
+    bool audible() const { return running() && lengthCounter > 0 && linearCounter > 0; }
+
+    bool clockTimer(uint32_t clocks) { // True when the sequencer moved
+        if (!running()) return false;
+        uint32_t moves = clockDivider(timerValue, timerPeriod, clocks);
+        if (moves == 0 || lengthCounter == 0 || linearCounter == 0) return false;
+        step = (step + moves) & 0x1F;
+        return true;
     }
 
     void clockLinear() {
@@ -219,15 +248,35 @@ struct NoiseChannel {
     bool enabled = false;
 
     static const uint16_t PERIOD_TABLE[16];
+    // The shift register is linear over GF(2): JUMPS[mode][i] holds the 15 columns of
+    // its 2^i-step matrix, so a long silent stretch is a handful of XORs
+    static uint16_t JUMPS[2][32][15];
+    static void buildJumps();
+
+    uint16_t shift() const {
+        uint16_t feedback = (shiftRegister & 1) ^ ((mode ? (shiftRegister >> 6) : (shiftRegister >> 1)) & 1);
+        return (shiftRegister >> 1) | (feedback << 14);
+    }
 
-    void clockTimer() {
-        if (timerValue == 0) {
-            timerValue = timerPeriod;
-            uint16_t feedback = (shiftRegister & 1) ^ ((mode ? (shiftRegister >> 6) : (shiftRegister >> 1)) & 1);
-            shiftRegister = (shiftRegister >> 1) | (feedback << 14);
+    bool audible() const {
+        return enabled && lengthCounter > 0 && (constantVolume ? constantVolumeValue : envelopeVolume) > 0;
+    }
+
+    bool clockTimer(uint32_t clocks) { // True when the shift register moved
+        uint32_t moves = clockDivider(timerValue, timerPeriod, clocks);
+        if (moves < 16) {
+            for (uint32_t i = 0; i < moves; i++) shiftRegister = shift();
         } else {
-            timerValue--;
+            for (int bit = 0; bit < 32; bit++) {
+                if (!(moves & (1u << bit))) continue;
+                uint16_t next = 0;
+                for (int c = 0; c < 15; c++) {
+                    if (shiftRegister & (1 << c)) next ^= JUMPS[mode][bit][c];
+                }
+                shiftRegister = next;
+            }
         }
+        return moves != 0;
     }
 
     void clockEnvelope() {
@@ -281,10 +330,18 @@ struct APU {
     DMCChannel dmc;
     AudioRingBuffer ringBuffer;
     
-    // Timing
+    bool apuClock = false;          // Pulse and noise timers clock on every other CPU cycle
+
+    // Output: the mixed level goes into the band-limited buffer as a delta whenever
+    // a channel's output changes; endFrame() resolves the block into samples.
+    BlipBuffer blip;
+    uint32_t blipTime = 0;          // CPU cycles into the current block
+    uint64_t channelOutputs = 0;    // Last channel outputs, one per byte (pulse 1 lowest)
+    int32_t level = 0;              // Last mixed level, LEVEL_ONE = mixer output 1.0
     uint32_t totalSamplesGenerated = 0;
-    double accumulatedCycles = 0;
-    float filterAccumulator = 128.0f;
+    AudioFilterChain filters;
+    Resampler resampler;
+    double outputRate = INTERNAL_RATE; // Device rate; survives reset()
     
     // Frame Counter ($4017)
     bool frameCounterMode = false; // false=4-step, true=5-step
@@ -294,24 +351,44 @@ struct APU {
     
     // NTSC Constants
     static constexpr double CPU_FREQ = 1789773.0;
-    static constexpr double SAMPLE_RATE = 44100.0;
-    static constexpr double CYCLES_PER_SAMPLE = CPU_FREQ / SAMPLE_RATE;
+    static constexpr double INTERNAL_RATE = 48000.0;  // Blip buffer and filters
+    static constexpr int32_t LEVEL_ONE = 1 << 15;
+    static constexpr float OUTPUT_GAIN = 600.0f * 256; // 16-bit steps per mixer output 1.0
+    // Drift control: the output rate is trimmed by up to MAX_DRIFT to hold the ring
+    // buffer half full, DRIFT_GAIN per unit of buffer error.
+    static constexpr double MAX_DRIFT = 0.005;
+    static constexpr double DRIFT_GAIN = 0.05;
+    static constexpr uint32_t MAX_BLOCK_CLOCKS = 1 << 15; // Well inside BlipBuffer::MAX_SAMPLES
     
     // Frame Counter timing (CPU cycles)
     // 4-step mode: Quarter frames at 3729, 7457, 11186, 14915
     // Half frames at 7457, 14915
     static constexpr uint32_t FRAME_COUNTER_RATE = 14915;
     static const uint8_t LENGTH_TABLE[32];
+    // Mixer output in LEVEL_ONE units, by pulse1 + pulse2 and by 3 * triangle + 2 * noise + DMC
+    static int32_t PULSE_TABLE[31];
+    static int32_t TND_TABLE[203];
+    static void buildMixerTables();
 
     void reset();
     void write(uint16_t addr, uint8_t val);
     void step(int cycles);
+    void endFrame();                 // Audio block ends here: samples go to the ring buffer
+    void setOutputRate(double rate); // Device sample rate
+    void catchUp(uint64_t cpuCycle); // Runs the cycles owed since syncedCycle, then reposts FrameIrq
     uint8_t readStatus();
+    int clocksUntilFrameIrq() const; // INT_MAX when the frame counter can't raise one
     
-    struct CPU* cpu = nullptr;
+    struct CPU* cpu = nullptr;          // IRQ line
+    Scheduler* scheduler = nullptr;     // Posts Event::FrameIrq
+    uint64_t syncedCycle = 0;           // CPU cycle the APU has been run up to
     
     void clockQuarterFrame();
     void clockHalfFrame();
+    void clockFrameCounter();       // frameCounterCycles just reached a step
+    uint32_t clocksUntilFrameStep() const;
+    bool clockTimers(uint32_t cycles); // True when a sequencer moved
+    void updateLevel();             // After anything that can change a channel's output
 };
 
 #endif
@@ -0,0 +1,125 @@
+#include "audio_filter.h"
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+void filterScalar(FilterSection& s, float* samples, int count) {
+    float lastIn = s.lastIn;
+    float y = s.lastOut;
+    for (int i = 0; i < count; i++) {
+        float x = samples[i];
+        y = s.k * y + s.gain * (s.highPass ? x - lastIn : x);
+        lastIn = x;
+        samples[i] = y;
+    }
+    s.lastIn = lastIn;
+    s.lastOut = y;
+}
+
+// Four samples per step. With u the inputs, the outputs are
+//   y[i] = k^(i+1) * y[-1] + sum(j <= i) k^(i-j) * u[j]
+// and the sum is two shift-and-add passes: u += k * (u >> 1 lane), u += k^2 * (u >> 2 lanes).
+#if defined(__SSE2__)
+inline __m128 shiftLanes1(__m128 v) { return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)); }
+inline __m128 shiftLanes2(__m128 v) { return _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)); }
+
+void filterSse2(FilterSection& s, float* samples, int count) {
+    const float k = s.k;
+    const __m128 k1 = _mm_set1_ps(k);
+    const __m128 k2 = _mm_set1_ps(k * k);
+    const __m128 powers = _mm_setr_ps(k, k * k, k * k * k, k * k * k * k);
+    const __m128 gain = _mm_set1_ps(s.gain);
+    float lastIn = s.lastIn;
+    float y = s.lastOut;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(samples + i);
+        __m128 u = x;
+        if (s.highPass) u = _mm_sub_ps(x, _mm_move_ss(shiftLanes1(x), _mm_set_ss(lastIn)));
+        u = _mm_mul_ps(u, gain);
+        u = _mm_add_ps(u, _mm_mul_ps(k1, shiftLanes1(u)));
+        u = _mm_add_ps(u, _mm_mul_ps(k2, shiftLanes2(u)));
+        __m128 out = _mm_add_ps(u, _mm_mul_ps(powers, _mm_set1_ps(y)));
+        _mm_storeu_ps(samples + i, out);
+        lastIn = _mm_cvtss_f32(_mm_shuffle_ps(x, x, _MM_SHUFFLE(3, 3, 3, 3)));
+        y = _mm_cvtss_f32(_mm_shuffle_ps(out, out, _MM_SHUFFLE(3, 3, 3, 3)));
+    }
+    s.lastIn = lastIn;
+    s.lastOut = y;
+    filterScalar(s, samples + i, count - i);
+}
+#endif
+
+#if defined(__aarch64__)
+void filterNeon(FilterSection& s, float* samples, int count) {
+    const float k = s.k;
+    const float powerTable[4] = {k, k * k, k * k * k, k * k * k * k};
+    const float32x4_t powers = vld1q_f32(powerTable);
+    const float32x4_t zero = vdupq_n_f32(0);
+    float lastIn = s.lastIn;
+    float y = s.lastOut;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(samples + i);
+        float32x4_t u = x;
+        if (s.highPass) u = vsubq_f32(x, vextq_f32(vdupq_n_f32(lastIn), x, 3));
+        u = vmulq_n_f32(u, s.gain);
+        u = vaddq_f32(u, vmulq_n_f32(vextq_f32(zero, u, 3), k));
+        u = vaddq_f32(u, vmulq_n_f32(vextq_f32(zero, u, 2), k * k));
+        float32x4_t out = vaddq_f32(u, vmulq_n_f32(powers, y));
+        vst1q_f32(samples + i, out);
+        lastIn = vgetq_lane_f32(x, 3);
+        y = vgetq_lane_f32(out, 3);
+    }
+    s.lastIn = lastIn;
+    s.lastOut = y;
+    filterScalar(s, samples + i, count - i);
+}
+#endif
+
+// One RC section: the high-pass passes k * (x[n] - x[n-1]), the low-pass (1 - k) * x[n]
+void setSection(FilterSection& s, double cutoff, double sampleRate, bool highPass) {
+    const double pi = 3.14159265358979323846;
+    double rc = 1.0 / (2 * pi * cutoff);
+    double dt = 1.0 / sampleRate;
+    s.k = (float)(rc / (rc + dt));
+    s.gain = highPass ? s.k : 1.0f - s.k;
+    s.highPass = highPass;
+}
+
+} // namespace
+
+void AudioFilterChain::setRate(double sampleRate) {
+    setSection(sections[0], 90.0, sampleRate, true);
+    setSection(sections[1], 440.0, sampleRate, true);
+    setSection(sections[2], 14000.0, sampleRate, false);
+}
+
+void AudioFilterChain::reset() {
+    for (FilterSection& s : sections) {
+        s.lastIn = 0;
+        s.lastOut = 0;
+    }
+}
+
+const KernelTable<AudioFilterKernel, AudioFilterFn>& audioFilterKernels() {
+    static const KernelEntry<AudioFilterKernel, AudioFilterFn> list[] = {
+        {AudioFilterKernel::Neon, "NEON", NEON_KERNEL(filterNeon)},
+        {AudioFilterKernel::Sse2, "SSE2", SSE2_KERNEL(filterSse2)},
+        {AudioFilterKernel::Scalar, "scalar", filterScalar},
+    };
+    static const KernelTable<AudioFilterKernel, AudioFilterFn> table(list);
+    return table;
+}
+
+void filterBlock(AudioFilterChain& chain, float* samples, int count) {
+    static const AudioFilterFn kernel = audioFilterKernels().bestFn();
+    for (FilterSection& s : chain.sections) kernel(s, samples, count);
+}
@@ -0,0 +1,41 @@
+/*
+ * Audio Filter Module
+ * Responsibility: The console's analog output stage, run over whole blocks of mixer
+ * levels: a 90Hz and a 440Hz first-order high-pass, then a 14kHz first-order low-pass.
+ * Every section is y[n] = k * y[n-1] + u[n]. The SSE2 and NEON kernels resolve that
+ * recursion four samples at a time, so they agree with the scalar one to float
+ * rounding rather than bit for bit.
+ */
+
+#ifndef AUDIO_FILTER_H
+#define AUDIO_FILTER_H
+
+#include <cstdint>
+#include "kernel_dispatch.h"
+
+enum class AudioFilterKernel : uint8_t { Scalar, Sse2, Neon, Count };
+
+struct FilterSection {
+    float k = 0;            // Feedback
+    float gain = 0;         // Input gain
+    bool highPass = false;  // Input is x[n] - x[n-1] rather than x[n]
+    float lastIn = 0;
+    float lastOut = 0;
+};
+
+struct AudioFilterChain {
+    static constexpr int SECTIONS = 3;
+    FilterSection sections[SECTIONS];
+
+    void setRate(double sampleRate); // Coefficients only: the state carries on
+    void reset();
+};
+
+typedef void (*AudioFilterFn)(FilterSection& section, float* samples, int count);
+
+const KernelTable<AudioFilterKernel, AudioFilterFn>& audioFilterKernels();
+
+// Runs `count` samples through every section, in place, with the best kernel.
+void filterBlock(AudioFilterChain& chain, float* samples, int count);
+
+#endif
@@ -0,0 +1,230 @@
+#include "benchmark.h"
+#include "cpu.h"
+#include "ppu.h"
+#include "mapper.h"
+#include "rom.h"
+#include "dynarec.h"
+#include "compositor.h"
+#include "audio_filter.h"
+#include "resampler.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <android/log.h>
+
+#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "NesoBench", __VA_ARGS__)
+
+// Synthetic NROM workload at $8000. Official opcodes only, so both cores agree:
+//   loop:  LDA $0200,X / CLC / ADC #$3B / STA $0200,X / EOR $10 / STA $10 / LDY #4
+//   inner: LDA ($20),Y / ASL A / ROL $11 / SBC $11 / STA ($20),Y / CMP #$80 / BCC +2 / INC $12
+//          DEY / BNE inner / JSR sub / INX / JMP loop
+//   sub:   LSR $13 / BIT $12 / PHA / PLA / RTS
+static const uint8_t BENCH_PROGRAM[] = {
+    0xA2, 0x00, 0xBD, 0x00, 0x02, 0x18, 0x69, 0x3B, 0x9D, 0x00, 0x02, 0x45, 0x10, 0x85, 0x10, 0xA0,
+    0x04, 0xB1, 0x20, 0x0A, 0x26, 0x11, 0xE5, 0x11, 0x91, 0x20, 0xC9, 0x80, 0x90, 0x02, 0xE6, 0x12,
+    0x88, 0xD0, 0xEE, 0x20, 0x2A, 0x80, 0xE8, 0x4C, 0x02, 0x80, 0x46, 0x13, 0x24, 0x12, 0x48, 0x68,
+    0x60
+};
+
+static std::vector<uint8_t> buildBenchRom() {
+    std::vector<uint8_t> image(16 + 32768 + 8192, 0);
+    const uint8_t header[8] = { 'N', 'E', 'S', 0x1A, 2, 1, 0, 0 };
+    for (int i = 0; i < 8; i++) image[i] = header[i];
+    uint8_t* prg = &image[16];
+    for (size_t i = 0; i < sizeof(BENCH_PROGRAM); i++) prg[i] = BENCH_PROGRAM[i];
+    prg[0x7FFC] = 0x00; // Reset vector -> $8000
+    prg[0x7FFD] = 0x80;
+    return image;
+}
+
+// Scratch system: the workload never touches I/O, the PPU is only there to satisfy the bus.
+struct BenchSystem {
+    Rom rom;
+    Mapper0 mapper;
+    PPU ppu{};
+    CPU cpu{};
+
+    explicit BenchSystem(const std::vector<uint8_t>& image)
+        : rom(image.data(), image.size()), mapper(&rom) {
+        ppu.reset();
+        ppu.mapper = &mapper;
+        cpu.ppu = &ppu;
+        cpu.mapper = &mapper;
+        cpu.reset();
+    }
+};
+
+template<typename StepFn>
+static double measureIps(uint64_t instructions, StepFn stepFn) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < instructions; i++) stepFn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() > 0 ? instructions / elapsed.count() : 0;
+}
+
+// Every supported kernel of `table`: `check(kernel)` compares its output with the
+// scalar one, then `run(kernel)` is timed over `units` units of work. Fills
+// perSec[kind] and logs each rate and the kernel in use.
+template<typename Kind, typename Fn, typename Check, typename Run>
+static void benchKernels(const KernelTable<Kind, Fn>& table, const char* label, const char* unit,
+                         uint64_t units, double* perSec, Check check, Run run) {
+    for (int k = 0; k < (int)Kind::Count; k++) {
+        Fn kernel = table.get((Kind)k);
+        if (!kernel) continue;
+        check(kernel);
+        auto start = std::chrono::steady_clock::now();
+        run(kernel);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        perSec[k] = elapsed.count() > 0 ? units / elapsed.count() : 0;
+        LOGD("%s bench: %s %.1f M%s/s", label, table.name((Kind)k), perSec[k] / 1e6, unit);
+    }
+    LOGD("%s bench: active %s", label, table.name(table.best()));
+}
+
+CpuBenchmarkResult runCpuBenchmark(uint64_t instructions) {
+    std::vector<uint8_t> image = buildBenchRom();
+    CpuBenchmarkResult result;
+    result.instructions = instructions;
+
+    BenchSystem tableSys(image);
+    result.tableIps = measureIps(instructions, [&]() { tableSys.cpu.step(); });
+
+    BenchSystem switchSys(image);
+    result.switchIps = measureIps(instructions, [&]() { switchSys.cpu.stepLegacy(); });
+
+    BenchSystem cachedSys(image);
+    cachedSys.cpu.setBlockCache(true);
+    result.cachedIps = measureIps(instructions, [&]() { cachedSys.cpu.step(); });
+
+    if (Dynarec::supported()) {
+        // step() returns whole native blocks here, so run until the same emulated
+        // cycle count the table core reached and credit the same instruction count.
+        BenchSystem dynarecSys(image);
+        dynarecSys.cpu.setDynarec(true);
+        uint64_t targetCycles = tableSys.cpu.totalCycles;
+        auto start = std::chrono::steady_clock::now();
+        while (dynarecSys.cpu.totalCycles < targetCycles) dynarecSys.cpu.step();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        result.dynarecIps = elapsed.count() > 0 ? instructions / elapsed.count() : 0;
+    }
+
+    LOGD("CPU bench (%llu instr): table %.2f MIPS | switch %.2f MIPS | x%.2f | cached %.2f MIPS | dynarec %.2f MIPS",
+         (unsigned long long)instructions, result.tableIps / 1e6, result.switchIps / 1e6,
+         result.switchIps > 0 ? result.tableIps / result.switchIps : 0.0, result.cachedIps / 1e6,
+         result.dynarecIps / 1e6);
+    return result;
+}
+
+// Random background values and sprite entries (about 1 in 4 pixels covered), fixed seed
+CompositorBenchmarkResult runCompositorBenchmark(int lines) {
+    static constexpr int WIDTH = 256;
+    static constexpr int SET = 64; // Distinct scanlines cycled through
+    std::vector<uint8_t> bg(SET * WIDTH), spr(SET * WIDTH);
+    uint32_t seed = 0x1234567;
+    auto next = [&]() { seed = seed * 1103515245 + 12345; return seed >> 16; };
+    for (int i = 0; i < SET * WIDTH; i++) {
+        bg[i] = next() & 0x0F;
+        spr[i] = (next() & 3) ? 0 : (next() & 0x6F);
+    }
+    uint8_t paletteTable[32];
+    for (int i = 0; i < 32; i++) paletteTable[i] = next() & 0x3F;
+    uint8_t colors[32];
+    buildLineColors(paletteTable, false, colors);
+
+    CompositorBenchmarkResult result;
+    result.pixels = (uint64_t)lines * WIDTH;
+    std::vector<uint8_t> reference(SET * WIDTH), out(SET * WIDTH);
+    const KernelTable<CompositorKernel, ComposeFn>& kernels = compositorKernels();
+    ComposeFn scalar = kernels.get(CompositorKernel::Scalar);
+    for (int l = 0; l < SET; l++) scalar(&bg[l * WIDTH], &spr[l * WIDTH], colors, &reference[l * WIDTH], WIDTH);
+
+    benchKernels(kernels, "Compositor", "px", result.pixels, result.pixelsPerSec,
+        [&](ComposeFn kernel) {
+            for (int l = 0; l < SET; l++) kernel(&bg[l * WIDTH], &spr[l * WIDTH], colors, &out[l * WIDTH], WIDTH);
+            if (out != reference) result.bitExact = false;
+        },
+        [&](ComposeFn kernel) {
+            for (int l = 0; l < lines; l++) {
+                int src = (l % SET) * WIDTH;
+                kernel(&bg[src], &spr[src], colors, &out[src], WIDTH);
+            }
+        });
+    LOGD("Compositor bench (%d lines): bit-exact %s", lines, result.bitExact ? "yes" : "NO");
+    return result;
+}
+
+// A square wave with noise on top, fixed seed; the chain state carries across blocks
+AudioFilterBenchmarkResult runAudioFilterBenchmark(int blocks) {
+    static constexpr int BLOCK = 800; // One frame at 48kHz
+    std::vector<float> signal(BLOCK);
+    uint32_t seed = 0x1234567;
+    for (int i = 0; i < BLOCK; i++) {
+        seed = seed * 1103515245 + 12345;
+        signal[i] = ((i / 37) & 1 ? 0.3f : 0.0f) + (seed >> 16 & 0xFF) * 0.0004f;
+    }
+
+    AudioFilterBenchmarkResult result;
+    result.samples = (uint64_t)blocks * BLOCK;
+    std::vector<float> reference(signal), out(BLOCK);
+    AudioFilterChain chain;
+    chain.setRate(48000.0);
+    chain.reset();
+    const KernelTable<AudioFilterKernel, AudioFilterFn>& kernels = audioFilterKernels();
+    AudioFilterFn scalar = kernels.get(AudioFilterKernel::Scalar);
+    for (FilterSection& section : chain.sections) scalar(section, reference.data(), BLOCK);
+
+    benchKernels(kernels, "Audio filter", "samples", result.samples, result.samplesPerSec,
+        [&](AudioFilterFn kernel) {
+            chain.reset();
+            out = signal;
+            for (FilterSection& section : chain.sections) kernel(section, out.data(), BLOCK);
+            for (int i = 0; i < BLOCK; i++) result.maxError = std::max(result.maxError, std::fabs(out[i] - reference[i]));
+        },
+        [&](AudioFilterFn kernel) {
+            for (int b = 0; b < blocks; b++) {
+                out = signal;
+                for (FilterSection& section : chain.sections) kernel(section, out.data(), BLOCK);
+            }
+        });
+    LOGD("Audio filter bench (%d blocks): max error %g", blocks, result.maxError);
+    return result;
+}
+
+ResamplerBenchmarkResult runResamplerBenchmark(int outputs) {
+    static constexpr int TAPS = Resampler::TAPS;
+    static constexpr int SPAN = 1024; // Input samples the positions sweep over
+    alignas(16) float rows[2][TAPS];
+    std::vector<float> signal(SPAN + TAPS);
+    uint32_t seed = 0x1234567;
+    for (float& v : signal) {
+        seed = seed * 1103515245 + 12345;
+        v = (int)(seed >> 16 & 0xFF) * (1.0f / 128) - 1.0f;
+    }
+    for (int i = 0; i < TAPS; i++) {
+        rows[0][i] = signal[i] * (1.0f / TAPS);
+        rows[1][i] = signal[TAPS + i] * (1.0f / TAPS);
+    }
+
+    ResamplerBenchmarkResult result;
+    result.outputs = (uint64_t)outputs;
+    const KernelTable<ResamplerKernel, FirFn>& kernels = resamplerKernels();
+    FirFn scalar = kernels.get(ResamplerKernel::Scalar);
+    volatile float sink = 0;
+    benchKernels(kernels, "Resampler", "outputs", result.outputs, result.outputsPerSec,
+        [&](FirFn kernel) {
+            for (int i = 0; i < SPAN; i++) {
+                float blend = (i & 63) * (1.0f / 64);
+                float a = kernel(signal.data() + i, rows[0], rows[1], blend);
+                float b = scalar(signal.data() + i, rows[0], rows[1], blend);
+                result.maxError = std::max(result.maxError, std::fabs(a - b));
+            }
+        },
+        [&](FirFn kernel) {
+            for (int n = 0; n < outputs; n++) {
+                sink = sink + kernel(signal.data() + (n & (SPAN - 1)), rows[0], rows[1], (n & 63) * (1.0f / 64));
+            }
+        });
+    LOGD("Resampler bench (%d outputs): max error %g", outputs, result.maxError);
+    return result;
+}
@@ -0,0 +1,53 @@
+/*
+ * Benchmark Module
+ * Responsibility: Self-contained throughput measurements of core hot paths.
+ * Each benchmark builds its own scratch system, so it never touches the running game.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstdint>
+#include "compositor.h"
+#include "audio_filter.h"
+#include "resampler.h"
+
+struct CpuBenchmarkResult {
+    uint64_t instructions = 0;
+    double tableIps = 0;  // Instructions/sec, table-driven core (CPU::step)
+    double switchIps = 0; // Instructions/sec, original switch core (CPU::stepLegacy)
+    double cachedIps = 0; // Instructions/sec, table core fed from the block cache
+    double dynarecIps = 0; // Instructions/sec equivalent (same emulated cycles), 0 where unsupported
+};
+
+// Runs the same synthetic instruction mix through every interpreter mode.
+CpuBenchmarkResult runCpuBenchmark(uint64_t instructions);
+
+struct CompositorBenchmarkResult {
+    uint64_t pixels = 0;
+    double pixelsPerSec[(int)CompositorKernel::Count] = {0}; // 0 where unsupported
+    bool bitExact = true; // Every supported kernel reproduced the scalar output
+};
+
+// Composites the same random scanlines with every scanline compositor kernel.
+CompositorBenchmarkResult runCompositorBenchmark(int lines);
+
+struct AudioFilterBenchmarkResult {
+    uint64_t samples = 0;
+    double samplesPerSec[(int)AudioFilterKernel::Count] = {0}; // 0 where unsupported
+    float maxError = 0; // Largest difference from the scalar output (mixer output units)
+};
+
+// Filters the same frame-sized blocks of a pulse-like signal with every filter kernel.
+AudioFilterBenchmarkResult runAudioFilterBenchmark(int blocks);
+
+struct ResamplerBenchmarkResult {
+    uint64_t outputs = 0;
+    double outputsPerSec[(int)ResamplerKernel::Count] = {0}; // 0 where unsupported
+    float maxError = 0; // Largest difference from the scalar output (input units)
+};
+
+// Runs the same noise through every resampler FIR kernel at a sweep of fractional positions.
+ResamplerBenchmarkResult runResamplerBenchmark(int outputs);
+
+#endif
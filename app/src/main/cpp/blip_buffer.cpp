@@ -0,0 +1,73 @@
+#include "blip_buffer.h"
+#include <cmath>
+#include <cstring>
+
+int16_t BlipBuffer::KERNEL[BlipBuffer::PHASES][BlipBuffer::WIDTH];
+
+// Blackman-windowed sinc, cut off a little below Nyquist so the window's transition
+// band stays out of the audible range. Each phase is rounded to integers summing to
+// exactly 1 << KERNEL_BITS, so the integrated level never drifts.
+void BlipBuffer::buildKernel() {
+    static bool built = false;
+    if (built) return;
+    const double pi = 3.14159265358979323846;
+    const double cutoff = 0.9; // Of Nyquist
+    for (int p = 0; p < PHASES; p++) {
+        double taps[WIDTH];
+        double sum = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            double x = (i - (HALF_WIDTH - 1)) - (p + 0.5) / PHASES; // Samples from the step
+            double w = (x + HALF_WIDTH) / WIDTH;                    // 0..1 across the window
+            double window = 0.42 - 0.5 * cos(2 * pi * w) + 0.08 * cos(4 * pi * w);
+            double sinc = x == 0 ? 1.0 : sin(pi * cutoff * x) / (pi * cutoff * x);
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+        int total = 0;
+        int peak = 0;
+        for (int i = 0; i < WIDTH; i++) {
+            KERNEL[p][i] = (int16_t)lround(taps[i] / sum * (1 << KERNEL_BITS));
+            total += KERNEL[p][i];
+            if (KERNEL[p][i] > KERNEL[p][peak]) peak = i;
+        }
+        KERNEL[p][peak] += (1 << KERNEL_BITS) - total;
+    }
+    built = true;
+}
+
+BlipBuffer::BlipBuffer() {
+    buildKernel();
+    clear();
+}
+
+void BlipBuffer::setRates(double clockRate, double sampleRate) {
+    factor = (uint64_t)llround(sampleRate / clockRate * (double)(1ULL << TIME_BITS));
+}
+
+void BlipBuffer::clear() {
+    offset = 0;
+    integrator = 0;
+    memset(buffer, 0, sizeof(buffer));
+}
+
+void BlipBuffer::endFrame(uint32_t clockDuration) {
+    offset += clockDuration * factor;
+}
+
+int BlipBuffer::readSamples(int32_t* out, int maxCount) {
+    int available = samplesAvailable();
+    int count = maxCount < available ? maxCount : available;
+    int32_t sum = integrator;
+    for (int i = 0; i < count; i++) {
+        sum += buffer[i];
+        out[i] = sum >> KERNEL_BITS;
+    }
+    integrator = sum;
+
+    // The impulses of the next block already reach WIDTH samples past the last whole one
+    int remaining = available - count + WIDTH;
+    memmove(buffer, buffer + count, remaining * sizeof(buffer[0]));
+    memset(buffer + remaining, 0, count * sizeof(buffer[0]));
+    offset -= (uint64_t)count << TIME_BITS;
+    return count;
+}
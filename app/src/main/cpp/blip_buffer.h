@@ -0,0 +1,57 @@
+/*
+ * Band-Limited Synthesis Module
+ * Responsibility: Turn amplitude steps placed on the CPU clock into PCM samples
+ * without aliasing. A step is not point-sampled: it is added to the buffer as a
+ * band-limited impulse (a windowed sinc, picked from one of PHASES sub-sample
+ * offsets), and reading integrates the impulses back into levels. Deltas go in
+ * whenever the source changes; samples come out in blocks, after endFrame().
+ */
+
+#ifndef BLIP_BUFFER_H
+#define BLIP_BUFFER_H
+
+#include <cstdint>
+
+class BlipBuffer {
+public:
+    static constexpr int MAX_SAMPLES = 2048;  // Unread samples the buffer holds
+    static constexpr int HALF_WIDTH = 8;      // Impulse taps either side of the step
+    static constexpr int WIDTH = 2 * HALF_WIDTH;
+    static constexpr int PHASE_BITS = 6;
+    static constexpr int PHASES = 1 << PHASE_BITS;
+    static constexpr int KERNEL_BITS = 13;    // Each impulse sums to exactly 1 << KERNEL_BITS
+    static constexpr int TIME_BITS = 32;      // Fraction bits of a sample position
+
+    BlipBuffer();
+
+    void setRates(double clockRate, double sampleRate);
+    void clear();
+
+    // Amplitude changes by `delta` at `clockTime` clocks into the current block.
+    // Deltas must stay below 1 << (31 - KERNEL_BITS - 2) to keep headroom.
+    void addDelta(uint32_t clockTime, int32_t delta) {
+        uint64_t t = offset + clockTime * factor;
+        int32_t* out = &buffer[t >> TIME_BITS];
+        const int16_t* taps = KERNEL[(t >> (TIME_BITS - PHASE_BITS)) & (PHASES - 1)];
+        for (int i = 0; i < WIDTH; i++) out[i] += delta * taps[i];
+    }
+
+    // Closes the block `clockDuration` clocks long: its samples can be read.
+    void endFrame(uint32_t clockDuration);
+
+    int samplesAvailable() const { return (int)(offset >> TIME_BITS); }
+
+    // Levels in the units of the deltas, delayed by HALF_WIDTH - 1 samples.
+    int readSamples(int32_t* out, int maxCount);
+
+private:
+    static int16_t KERNEL[PHASES][WIDTH];
+    static void buildKernel();
+
+    uint64_t factor = 0;   // Sample positions per clock, TIME_BITS fraction
+    uint64_t offset = 0;   // Sample position of the block start
+    int32_t integrator = 0;
+    int32_t buffer[MAX_SAMPLES + WIDTH];
+};
+
+#endif
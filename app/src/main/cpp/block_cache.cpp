@@ -0,0 +1,91 @@
+#include "block_cache.h"
+#include <algorithm>
+
+// Unconditional control flow ends a block; conditional branches don't; the not-taken
+// path keeps running from the same block, the taken path simply misses the cursor.
+bool BlockCache::endsBlock(uint8_t opcode) {
+    switch (opcode) {
+        case 0x00: // BRK
+        case 0x20: // JSR
+        case 0x40: // RTI
+        case 0x4C: // JMP abs
+        case 0x60: // RTS
+        case 0x6C: // JMP ind
+            return true;
+        default:
+            // JAM: $x2 for x in 0-7, 9, B, D, F
+            return (opcode & 0x0F) == 0x02 && (opcode < 0x80 || (opcode & 0x10));
+    }
+}
+
+const DecodedBlock* BlockCache::lookup(CPU& cpu) {
+    int page = CpuPageTable::page(cpu.pc);
+    const uint8_t* base = pages.read[page];
+    if (!base) return nullptr;
+
+    uint16_t offset = cpu.pc & CpuPageTable::PAGE_MASK;
+    const uint8_t* host = base + offset;
+    DecodedBlock*& cached = fast[slot(host)];
+    if (cached && cached->source == host) return cached;
+
+    auto it = blocks.find(host);
+    DecodedBlock* found = (it != blocks.end()) ? it->second.get() : decode(host, page, offset);
+    if (found) cached = found;
+    return found;
+}
+
+DecodedBlock* BlockCache::decode(const uint8_t* host, int page, uint16_t offset) {
+    std::unique_ptr<DecodedBlock> b(new DecodedBlock());
+    b->source = host;
+    b->fromRam = pages.writable[page] != nullptr;
+
+    const uint8_t* base = pages.read[page];
+    uint32_t off = offset;
+    while (b->count < DecodedBlock::MAX_OPS) {
+        uint8_t opcode = base[off];
+        const CPU::Opcode& op = CPU::OPCODES[opcode];
+        if (off + op.bytes > (uint32_t)CpuPageTable::PAGE_SIZE) break; // Operand lives in the next page
+
+        uint16_t operand = 0;
+        if (op.bytes > 1) {
+            operand = base[off + 1];
+            if (op.bytes > 2) operand |= base[off + 2] << 8;
+        }
+        b->ops[b->count++] = { op.execute, operand, op.bytes, op.cycles };
+        off += op.bytes;
+        if (endsBlock(opcode)) break;
+    }
+    if (b->count == 0) return nullptr;
+    b->length = (uint16_t)(off - offset);
+
+    DecodedBlock* raw = b.get();
+    if (raw->fromRam) {
+        ramBlocks.push_back(raw);
+        pages.watchCode(page);
+    }
+    blocks[host] = std::move(b);
+    blocksDecoded++;
+    return raw;
+}
+
+void BlockCache::invalidate(const uint8_t* host) {
+    for (size_t i = 0; i < ramBlocks.size(); ) {
+        DecodedBlock* b = ramBlocks[i];
+        if (host < b->source || host >= b->source + b->length) { i++; continue; }
+
+        if (block == b) block = nullptr;
+        DecodedBlock*& cached = fast[slot(b->source)];
+        if (cached == b) cached = nullptr;
+        ramBlocks[i] = ramBlocks.back();
+        ramBlocks.pop_back();
+        blocks.erase(b->source);
+        blocksInvalidated++;
+    }
+}
+
+void BlockCache::clear() {
+    block = nullptr;
+    ramBlocks.clear();
+    blocks.clear();
+    std::fill(fast, fast + FAST_SLOTS, nullptr);
+}
@@ -0,0 +1,84 @@
+/*
+ * Block Cache Module
+ * Responsibility: Pre-decoded instruction runs for the cached interpreter mode.
+ * A block is keyed by the host address of its first opcode byte, which already encodes
+ * both the PC and the PRG bank mapped there. Blocks never cross a CPU page.
+ */
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "cpu.h"
+
+struct DecodedOp {
+    int (*execute)(CPU& cpu, uint16_t operand);
+    uint16_t operand;
+    uint8_t bytes;
+    uint8_t cycles;
+};
+
+struct DecodedBlock {
+    static constexpr int MAX_OPS = 32;
+    const uint8_t* source = nullptr; // Host address of the first opcode byte (cache key)
+    uint16_t length = 0;             // Bytes covered
+    uint8_t count = 0;
+    bool fromRam = false;            // Decoded from writable memory, subject to invalidation
+    DecodedOp ops[MAX_OPS];
+};
+
+class BlockCache {
+public:
+    explicit BlockCache(CpuPageTable& pageTable) : pages(pageTable) {}
+    ~BlockCache() { clear(); }
+
+    // Pre-decoded instruction at cpu.pc, or null when pc is not in plain memory
+    // (the caller then fetches from the bus as usual).
+    inline const DecodedOp* next(CPU& cpu);
+
+    void invalidate(const uint8_t* host); // A byte in a WATCH_CODE page was written
+    void clear();                         // Drops every block (watched pages are released by the CPU)
+
+    static bool endsBlock(uint8_t opcode); // JMP/JSR/RTS/RTI/BRK/JAM
+
+    // Telemetry
+    uint64_t blocksDecoded = 0;
+    uint64_t blocksInvalidated = 0;
+
+private:
+    static constexpr int FAST_SLOTS = 1024;
+
+    const DecodedBlock* lookup(CPU& cpu);
+    DecodedBlock* decode(const uint8_t* host, int page, uint16_t offset);
+    static int slot(const uint8_t* host) { return ((uintptr_t)host ^ ((uintptr_t)host >> 10)) & (FAST_SLOTS - 1); }
+
+    CpuPageTable& pages;
+    std::unordered_map<const uint8_t*, std::unique_ptr<DecodedBlock>> blocks;
+    std::vector<DecodedBlock*> ramBlocks;
+    DecodedBlock* fast[FAST_SLOTS] = {nullptr}; // Direct-mapped front of `blocks`
+
+    // Cursor: sequential execution continues inside the current block until the PC or
+    // the bank mapping changes underneath it.
+    const DecodedBlock* block = nullptr;
+    int index = 0;
+    uint16_t cursorPc = 0;
+    uint32_t cursorGeneration = 0;
+};
+
+inline const DecodedOp* BlockCache::next(CPU& cpu) {
+    if (!block || cpu.pc != cursorPc || pages.generation != cursorGeneration) {
+        block = lookup(cpu);
+        if (!block) return nullptr;
+        index = 0;
+        cursorGeneration = pages.generation;
+    }
+    const DecodedOp* op = &block->ops[index];
+    cursorPc = cpu.pc + op->bytes;
+    if (++index == block->count) block = nullptr;
+    return op;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#include "chr_cache.h"
+#include <cstring>
+
+void ChrTileCache::attach(const std::vector<uint8_t>* chr) {
+    source = chr;
+    tileCount = chr ? (uint32_t)(chr->size() / TILE_BYTES) : 0;
+    tiles.assign(tileCount + TILES_PER_WINDOW, Tile{});
+    stale.assign(tileCount + TILES_PER_WINDOW, 0);
+    memset(stale.data(), 1, tileCount);
+    map(0x0000, 0x2000, 0);
+}
+
+void ChrTileCache::map(uint16_t start, uint32_t size, uint32_t chrOffset) {
+    for (uint32_t off = 0; off < size; off += WINDOW_SIZE) {
+        uint32_t first = (chrOffset + off) / TILE_BYTES;
+        bool inRange = first + TILES_PER_WINDOW <= tileCount;
+        window[((start + off) >> WINDOW_SHIFT) & (WINDOW_COUNT - 1)] = inRange ? first : tileCount;
+    }
+}
+
+void ChrTileCache::decode(uint32_t index) {
+    const uint8_t* planes = source->data() + index * TILE_BYTES;
+    Tile& t = tiles[index];
+    for (int r = 0; r < 8; r++) {
+        uint8_t lo = planes[r];
+        uint8_t hi = planes[r + 8];
+        uint16_t row = 0, flipped = 0;
+        for (int c = 0; c < 8; c++) {
+            uint16_t pixel = ((lo >> (7 - c)) & 1) | (((hi >> (7 - c)) & 1) << 1);
+            row |= pixel << (14 - 2 * c);
+            flipped |= pixel << (2 * c);
+        }
+        t.rows[r] = row;
+        t.flipped[r] = flipped;
+    }
+    stale[index] = 0;
+    tilesDecoded++;
+}
@@ -0,0 +1,62 @@
+/*
+ * CHR Tile Cache Module
+ * Responsibility: Pattern memory pre-decoded into 2-bit pixels for the PPU pipelines.
+ * Each 16-byte tile is kept as eight rows of packed pixels (leftmost pixel in the top
+ * two bits, so a row shifts out exactly like the bitplane shift registers) plus the
+ * same rows mirrored for horizontally flipped sprites.
+ * The mapper points the 1KB windows of $0000-$1FFF at its current CHR banks and marks
+ * tiles stale when CHR-RAM is written; a stale tile is decoded again on its next fetch.
+ */
+
+#ifndef CHR_CACHE_H
+#define CHR_CACHE_H
+
+#include <cstdint>
+#include <vector>
+
+struct ChrTileCache {
+    static constexpr int TILE_BYTES = 16;
+    static constexpr int WINDOW_SHIFT = 10; // 1KB: finer than any supported CHR bank
+    static constexpr int WINDOW_SIZE = 1 << WINDOW_SHIFT;
+    static constexpr int WINDOW_COUNT = 0x2000 >> WINDOW_SHIFT;
+    static constexpr int TILES_PER_WINDOW = WINDOW_SIZE / TILE_BYTES;
+
+    struct Tile {
+        uint16_t rows[8];    // Pixel 0 in bits 15-14 ... pixel 7 in bits 1-0
+        uint16_t flipped[8]; // Same rows, mirrored
+    };
+
+    // Sizes the cache for `chr` (everything stale) and maps $0000-$1FFF straight onto it.
+    void attach(const std::vector<uint8_t>* chr);
+
+    // Points [start, start + size) of the pattern space at CHR offset `chrOffset`.
+    // Windows past the end of CHR memory read as blank tiles, like Rom::safeChrRead().
+    void map(uint16_t start, uint32_t size, uint32_t chrOffset);
+
+    // CHR memory at `chrOffset` was written.
+    void invalidate(uint32_t chrOffset) {
+        uint32_t index = chrOffset / TILE_BYTES;
+        if (index < tileCount) stale[index] = 1;
+    }
+
+    // Decoded row for the low-plane pattern address `addr` (tile * 16 + fine Y).
+    uint16_t row(uint16_t addr, bool flip) {
+        uint32_t index = window[(addr >> WINDOW_SHIFT) & (WINDOW_COUNT - 1)] + ((addr & (WINDOW_SIZE - 1)) / TILE_BYTES);
+        if (stale[index]) decode(index);
+        const Tile& t = tiles[index];
+        return flip ? t.flipped[addr & 7] : t.rows[addr & 7];
+    }
+
+    uint64_t tilesDecoded = 0;
+
+private:
+    const std::vector<uint8_t>* source = nullptr;
+    uint32_t tileCount = 0;               // Tiles backed by CHR memory; a blank window follows
+    std::vector<Tile> tiles;
+    std::vector<uint8_t> stale;
+    uint32_t window[WINDOW_COUNT] = {0};  // First tile index of each 1KB window
+
+    void decode(uint32_t index);
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include "compositor.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Sprite line entry bits (PPU::spriteLine)
+constexpr uint8_t SPRITE_PIXEL = 0x03;
+constexpr uint8_t SPRITE_COLOR = 0x0F;  // Palette and pixel: the low half of the color index
+constexpr uint8_t SPRITE_BEHIND = 0x20;
+constexpr uint8_t SPRITE_PALETTES = 0x10; // Sprite colors start at palette 4
+
+// The sprite wins when it is opaque, unless it sits behind an opaque background pixel.
+void composeScalar(const uint8_t* bg, const uint8_t* spr, const uint8_t* colors, uint8_t* out, int count) {
+    for (int x = 0; x < count; x++) {
+        uint8_t b = bg[x];
+        uint8_t s = spr[x];
+        bool front = (s & SPRITE_PIXEL) && !((b & 0x03) && (s & SPRITE_BEHIND));
+        out[x] = colors[front ? (SPRITE_PALETTES | (s & SPRITE_COLOR)) : b];
+    }
+}
+
+#if defined(__SSE2__)
+// Mux 16 pixels at a time; SSE2 has no byte shuffle, so the table lookup stays scalar.
+void composeSse2(const uint8_t* bg, const uint8_t* spr, const uint8_t* colors, uint8_t* out, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pixelMask = _mm_set1_epi8(SPRITE_PIXEL);
+    const __m128i behindMask = _mm_set1_epi8(SPRITE_BEHIND);
+    const __m128i colorMask = _mm_set1_epi8(SPRITE_COLOR);
+    const __m128i sprBase = _mm_set1_epi8(SPRITE_PALETTES);
+    alignas(16) uint8_t lanes[16];
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m128i b = _mm_loadu_si128((const __m128i*)(bg + x));
+        __m128i s = _mm_loadu_si128((const __m128i*)(spr + x));
+        __m128i sprClear = _mm_cmpeq_epi8(_mm_and_si128(s, pixelMask), zero);
+        __m128i bgClear = _mm_cmpeq_epi8(_mm_and_si128(b, pixelMask), zero);
+        __m128i behind = _mm_cmpeq_epi8(_mm_and_si128(s, behindMask), behindMask);
+        __m128i useBg = _mm_or_si128(sprClear, _mm_andnot_si128(bgClear, behind));
+        __m128i sprIndex = _mm_or_si128(_mm_and_si128(s, colorMask), sprBase);
+        __m128i idx = _mm_or_si128(_mm_and_si128(useBg, b), _mm_andnot_si128(useBg, sprIndex));
+        _mm_store_si128((__m128i*)lanes, idx);
+        for (int i = 0; i < 16; i++) out[x + i] = colors[lanes[i]];
+    }
+    composeScalar(bg + x, spr + x, colors, out + x, count - x);
+}
+#endif
+
+#if defined(__x86_64__)
+// Mux 32 pixels at a time; the 32-entry table is two 16-byte shuffles, picked by index bit 4.
+__attribute__((target("avx2")))
+void composeAvx2(const uint8_t* bg, const uint8_t* spr, const uint8_t* colors, uint8_t* out, int count) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i pixelMask = _mm256_set1_epi8(SPRITE_PIXEL);
+    const __m256i behindMask = _mm256_set1_epi8(SPRITE_BEHIND);
+    const __m256i colorMask = _mm256_set1_epi8(SPRITE_COLOR);
+    const __m256i sprBase = _mm256_set1_epi8(SPRITE_PALETTES);
+    const __m256i tableLo = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)colors));
+    const __m256i tableHi = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i*)(colors + 16)));
+    int x = 0;
+    for (; x + 32 <= count; x += 32) {
+        __m256i b = _mm256_loadu_si256((const __m256i*)(bg + x));
+        __m256i s = _mm256_loadu_si256((const __m256i*)(spr + x));
+        __m256i sprClear = _mm256_cmpeq_epi8(_mm256_and_si256(s, pixelMask), zero);
+        __m256i bgClear = _mm256_cmpeq_epi8(_mm256_and_si256(b, pixelMask), zero);
+        __m256i behind = _mm256_cmpeq_epi8(_mm256_and_si256(s, behindMask), behindMask);
+        __m256i useBg = _mm256_or_si256(sprClear, _mm256_andnot_si256(bgClear, behind));
+        __m256i sprIndex = _mm256_or_si256(_mm256_and_si256(s, colorMask), sprBase);
+        __m256i idx = _mm256_blendv_epi8(sprIndex, b, useBg);
+        __m256i upper = _mm256_slli_epi16(idx, 3); // Bit 4 -> bit 7, the blend selector
+        __m256i result = _mm256_blendv_epi8(_mm256_shuffle_epi8(tableLo, idx), _mm256_shuffle_epi8(tableHi, idx), upper);
+        _mm256_storeu_si256((__m256i*)(out + x), result);
+    }
+    composeScalar(bg + x, spr + x, colors, out + x, count - x);
+}
+#endif
+
+#if defined(__aarch64__)
+// Mux 16 pixels at a time; the 32-entry table is a single two-register lookup.
+void composeNeon(const uint8_t* bg, const uint8_t* spr, const uint8_t* colors, uint8_t* out, int count) {
+    uint8x16x2_t table;
+    table.val[0] = vld1q_u8(colors);
+    table.val[1] = vld1q_u8(colors + 16);
+    const uint8x16_t pixelMask = vdupq_n_u8(SPRITE_PIXEL);
+    const uint8x16_t behindMask = vdupq_n_u8(SPRITE_BEHIND);
+    const uint8x16_t colorMask = vdupq_n_u8(SPRITE_COLOR);
+    const uint8x16_t sprBase = vdupq_n_u8(SPRITE_PALETTES);
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        uint8x16_t b = vld1q_u8(bg + x);
+        uint8x16_t s = vld1q_u8(spr + x);
+        uint8x16_t sprOpaque = vtstq_u8(s, pixelMask);
+        uint8x16_t bgOpaque = vtstq_u8(b, pixelMask);
+        uint8x16_t behind = vtstq_u8(s, behindMask);
+        uint8x16_t front = vbicq_u8(sprOpaque, vandq_u8(bgOpaque, behind));
+        uint8x16_t idx = vbslq_u8(front, vorrq_u8(vandq_u8(s, colorMask), sprBase), b);
+        vst1q_u8(out + x, vqtbl2q_u8(table, idx));
+    }
+    composeScalar(bg + x, spr + x, colors, out + x, count - x);
+}
+#endif
+
+} // namespace
+
+const KernelTable<CompositorKernel, ComposeFn>& compositorKernels() {
+    static const KernelEntry<CompositorKernel, ComposeFn> list[] = {
+        {CompositorKernel::Neon, "NEON", NEON_KERNEL(composeNeon)},
+        {CompositorKernel::Avx2, "AVX2", AVX2_KERNEL(composeAvx2), cpuHasAvx2},
+        {CompositorKernel::Sse2, "SSE2", SSE2_KERNEL(composeSse2)},
+        {CompositorKernel::Scalar, "scalar", composeScalar},
+    };
+    static const KernelTable<CompositorKernel, ComposeFn> table(list);
+    return table;
+}
+
+void buildLineColors(const uint8_t* paletteTable, bool grayscale, uint8_t* colors) {
+    for (int i = 0; i < 32; i++) {
+        uint8_t paletteIndex = paletteTable[(i & 0x03) ? i : 0]; // Pixel 0: universal background color
+        if (grayscale) paletteIndex &= 0x30;
+        colors[i] = paletteIndex & 0x3F;
+    }
+}
+
+void composeScanline(const uint8_t* bg, const uint8_t* spr, const uint8_t* colors, uint8_t* out, int count) {
+    static const ComposeFn kernel = compositorKernels().bestFn();
+    kernel(bg, spr, colors, out, count);
+}
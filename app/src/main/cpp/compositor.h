@@ -0,0 +1,30 @@
+/*
+ * Compositor Module
+ * Responsibility: Turn one scanline of background and sprite pixels into system
+ * palette indices (video_output.h takes it from there).
+ * Input per pixel: the background value (palette << 2 | pixel, 0 where clipped) and
+ * the PPU::spriteLine entry (0 where clipped), plus the 32 indices palette RAM resolves
+ * to for this line. Kernels: scalar, SSE2 / AVX2 on x86, NEON on ARM64; every SIMD
+ * kernel must match the scalar one bit for bit.
+ */
+
+#ifndef COMPOSITOR_H
+#define COMPOSITOR_H
+
+#include <cstdint>
+#include "kernel_dispatch.h"
+
+enum class CompositorKernel : uint8_t { Scalar, Sse2, Avx2, Neon, Count };
+
+typedef void (*ComposeFn)(const uint8_t* bg, const uint8_t* spr, const uint8_t* colors, uint8_t* out, int count);
+
+const KernelTable<CompositorKernel, ComposeFn>& compositorKernels();
+
+// colors[palette * 4 + pixel]: the system palette index renderPixel() would output
+// for that pair (universal background color and grayscale applied).
+void buildLineColors(const uint8_t* paletteTable, bool grayscale, uint8_t* colors);
+
+// Composites `count` pixels with the best kernel.
+void composeScanline(const uint8_t* bg, const uint8_t* spr, const uint8_t* colors, uint8_t* out, int count);
+
+#endif
@@ -9,11 +9,15 @@
 
 #include <cstdint>
 #include <android/log.h>
+#include "memory_map.h"
+#include "idle_loop.h"
 #define NESO_LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "NesoCore", __VA_ARGS__)
 
 struct PPU;
 struct APU;
 class Mapper;
+class BlockCache;
+class Dynarec;
 
 struct Controller {
     uint8_t buttons = 0;       // Current button state (A B Select Start Up Down Left Right)
@@ -40,32 +44,84 @@ struct CPU {
     uint8_t status; // Status Flags (N V - B D I Z C)
 
     uint8_t ram[2048];    // 2KB Work RAM ($0000-$07FF)
+    CpuPageTable pages;   // Bus decode, rebuilt by reset(); the mapper owns $6000-$FFFF
     
     PPU* ppu; // Reference to PPU for Memory Mapped I/O
     class Mapper* mapper = nullptr; // Reference to Mapper
     Controller controller; // Controller Port 1
     struct APU* apu = nullptr; // Reference to APU
 
+    ~CPU();
     void reset();
     int step(); // Returns number of cycles consumed
+    void runUntil(uint64_t cycle); // Steps until totalCycles reaches `cycle`, taking interrupts between instructions
+    int stepLegacy(); // Original switch interpreter, benchmark baseline (cpu_legacy.cpp, NESO_BENCHMARKS builds)
     void triggerNMI();
     void triggerIRQ();
 
-    bool irqPending = false;
+    // Interrupt lines: one IRQ bit per source (level), NMI latched on the PPU's edge.
+    // Sampled by runUntil() between instructions; devices set them while catching up.
+    enum IrqSource : uint8_t { IRQ_FRAME_COUNTER = 0x01, IRQ_DMC = 0x02, IRQ_MAPPER = 0x04 };
+    uint8_t irqLines = 0;
+    bool nmiPending = false;
+    void setIrq(uint8_t source, bool active) { irqLines = active ? (irqLines | source) : (irqLines & ~source); }
+
     int cyclesToStall = 0; // For DMA ($4014) handling
-    uint64_t totalCycles = 0; // Cumulative cycles for timing
+    uint64_t totalCycles = 0; // Master clock (scheduler.h), stalls included
     
     uint32_t getChecksum(); // For Determinism (Layer D)
 
+    // Cached interpreter: step() pulls pre-decoded ops from a BlockCache instead of
+    // fetching opcode/operand bytes. Switchable at any instruction boundary.
+    BlockCache* blockCache = nullptr;
+    void setBlockCache(bool enabled);
+
+    // x86-64 recompiler for hot ROM/RAM runs (dynarec.h). Lockstep re-runs every
+    // translated instruction on the interpreter and logs any divergence.
+    Dynarec* dynarec = nullptr;
+    void setDynarec(bool enabled, bool lockstep = false);
+
+    // Idle-loop fast-forward (idle_loop.h): a settled polling loop is skipped in whole
+    // iterations up to the next PPU/APU event. runUntil() sets skipLimit to the cycles
+    // left before the next scheduled event (also the dynarec's block budget);
+    // skippedCycles is cleared by the frame loop.
+    IdleLoop idle;
+    bool idleSkip = true;
+    int skipLimit = 29780;
+    uint32_t skippedCycles = 0;
+    void setIdleSkip(bool enabled);
+
     inline void setZN(uint8_t val) {
         status = (status & ~0x82) | (val == 0 ? 0x02 : 0) | (val & 0x80);
     }
     
-    // Memory Map (Defined in cpu.cpp to avoid circular deps if needed, but inlined for perf)
+    // Memory Map: one indexed load for RAM/PRG, I/O handler slots otherwise (cpu.cpp)
     uint8_t read(uint16_t addr);
     void write(uint16_t addr, uint8_t val);
+    void writeWatched(uint16_t addr, uint8_t val); // Write to a page holding cached code
+    void mapPages();
+
+    // Instruction Table: one entry per opcode, built at compile time from
+    // addressing-mode x operation templates in cpu.cpp.
+    // `mode`/`access` describe the bus traffic for analysis (dynarec); hand-written
+    // entries (stack, jumps, SH*) are Special.
+    enum class AddrMode : uint8_t {
+        Special, Implied, Accumulator, Immediate, Relative,
+        ZeroPage, ZeroPageX, ZeroPageY, Absolute, AbsoluteX, AbsoluteY, IndirectX, IndirectY
+    };
+    enum class BusAccess : uint8_t { None, Read, Write, Modify };
+    struct Opcode {
+        int (*execute)(CPU& cpu, uint16_t operand); // Returns cycles beyond `cycles` (page cross, branch taken)
+        uint8_t bytes;  // Instruction length including the opcode
+        uint8_t cycles; // Base cycle count
+        AddrMode mode;
+        BusAccess access;
+    };
+    static const Opcode OPCODES[256];
 
 private:
+    friend struct CpuOps;
+
     void push(uint8_t val) { write(0x100 | sp--, val); }
     uint8_t pop() { return read(0x100 | ++sp); }
     uint16_t read16(uint16_t addr) {
@@ -82,57 +138,24 @@ void step(CPU& cpu);
 // We define these here (outside the struct but in the header) to allow include-based inlining
 // while avoiding member function definition order issues.
 
+#ifndef CPU_INLINE_H
+#define CPU_INLINE_H
+
 #include "ppu.h"
 #include "apu.h"
 #include "mapper.h"
 
 inline uint8_t CPU::read(uint16_t addr) {
-    if (addr <= 0x1FFF) return ram[addr & 0x7FF];
-    if (addr >= 0x2000 && addr <= 0x3FFF) return ppu->readRegister(addr);
-    if (addr == 0x4015 && apu) return apu->readStatus();
-    if (addr == 0x4016) return controller.read();
-    if (addr >= 0x4018 && mapper) return mapper->cpuRead(addr);
-    return 0x00;
+    int page = CpuPageTable::page(addr);
+    if (const uint8_t* mem = pages.read[page]) return mem[addr & CpuPageTable::PAGE_MASK];
+    return pages.ioRead[page](*this, addr);
 }
 
 inline void CPU::write(uint16_t addr, uint8_t val) {
-    if (addr <= 0x1FFF) ram[addr & 0x7FF] = val;
-    else if (addr >= 0x2000 && addr <= 0x3FFF) ppu->writeRegister(addr, val);
-    else if (addr == 0x4014) {
-        // OAM DMA: Copy 256 bytes to OAM
-        uint16_t base = (uint16_t)val << 8;
-        for (int i = 0; i < 256; i++) {
-            ((uint8_t*)ppu->sprites)[i] = read(base + i);
-        }
-        cyclesToStall = 513;
-    } else if (addr == 0x4016) {
-        if (val & 1) controller.latch();
-    } else if (addr >= 0x4000 && addr <= 0x4017 && apu) apu->write(addr, val);
-    else if (addr >= 0x4018 && mapper) {
-        if (addr == 0x6000) {
-            if (val == 0x00) {
-                NESO_LOGD("🧪 TEST PASS! (Writing 0x00 to $6000)");
-                // Try to read result string from $6004 if it looks like a test ROM
-                char msg[256];
-                for(int i=0; i<255; i++) {
-                    msg[i] = (char)mapper->cpuRead(0x6004 + i);
-                    if (msg[i] == 0) break;
-                    if (i == 254) msg[255] = 0;
-                }
-                NESO_LOGD("🧪 TEST MSG: %s", msg);
-            }
-            else if (val >= 0x80) NESO_LOGD("🧪 TEST RUNNING... (State: 0x%02X)", val);
-            else {
-                NESO_LOGD("🧪 TEST FAILED: 0x%02X", val);
-                char msg[256];
-                for(int i=0; i<255; i++) {
-                    msg[i] = (char)mapper->cpuRead(0x6004 + i);
-                    if (msg[i] == 0) break;
-                    if (i == 254) msg[255] = 0;
-                }
-                NESO_LOGD("🧪 FAIL MSG: %s", msg);
-            }
-        }
-        mapper->cpuWrite(addr, val, totalCycles);
-    }
-}
\ No newline at end of file
+    int page = CpuPageTable::page(addr);
+    if (uint8_t* mem = pages.write[page]) mem[addr & CpuPageTable::PAGE_MASK] = val;
+    else if (pages.flags[page] & CpuPageTable::WATCH_CODE) writeWatched(addr, val);
+    else pages.ioWrite[page](*this, addr, val);
+}
+
+#endif
@@ -0,0 +1,150 @@
+#include "deferred_ppu.h"
+#include "mapper.h"
+#include <cstring>
+
+// The worker's cartridge side: nametable RAM and CHR memory copied from the real board,
+// laid out by the logged mappings. It never decides where a write goes - the emulation
+// thread logs the byte each $2007 write left behind (a write lands where a read of the
+// same address comes from, on every supported board).
+class ReplayMapper : public Mapper {
+public:
+    ReplayMapper(Rom* image, const Mapper& board) : Mapper(image) {
+        memcpy(ppuVram, board.nametableRam(), sizeof(ppuVram));
+        ppuMapping = board.ppuMapping;
+    }
+
+    uint8_t ppuRead(uint16_t addr) override { return ppu ? ppu->pages.read(addr & 0x3FFF) : 0; }
+    void ppuWrite(uint16_t addr, uint8_t val) override {} // See poke()
+
+    void mapPpuPages() override {
+        for (int p = 0; p < PpuPageTable::CHR_PAGES; p++) {
+            int32_t offset = ppuMapping.chr[p];
+            mapChr(p * PpuPageTable::PAGE_SIZE, PpuPageTable::PAGE_SIZE, offset < 0 ? (uint32_t)rom->chrROM.size() : offset);
+        }
+        for (int n = 0; n < PpuPageTable::NAMETABLES; n++) {
+            if (ppu) ppu->pages.nametable[n] = &ppuVram[ppuMapping.nametable[n]];
+        }
+    }
+
+    // What Mapper::syncPpu() did on the emulation thread, at the same cycle
+    void remap(const PpuMapping& mapping) {
+        ppu->bumpGeneration();
+        if (ppu->nametables) ppu->nametables->invalidateAll();
+        ppuMapping = mapping;
+        mapPpuPages();
+    }
+
+    void poke(uint16_t addr, uint8_t val) {
+        if (addr < 0x2000) {
+            int32_t offset = ppuMapping.chr[addr >> PpuPageTable::PAGE_SHIFT];
+            if (offset < 0) return;
+            uint32_t at = offset + (addr & PpuPageTable::PAGE_MASK);
+            rom->chrROM[at] = val;
+            chrCache.invalidate(at);
+        } else {
+            ppuVram[ppuMapping.nametable[(addr >> PpuPageTable::PAGE_SHIFT) & 3] + (addr & PpuPageTable::PAGE_MASK)] = val;
+        }
+    }
+};
+
+DeferredRenderer::DeferredRenderer(PPU& emulated, const Mapper& board, const Rom& image)
+    : source(emulated), output(emulated.frames), rom(image), mapper(new ReplayMapper(&rom, board)) {
+    ppu.reset();
+    ppu.mapper = mapper.get();
+    mapper->attachPpu(&ppu);
+    ppu.copyState(source);
+    ppu.setOutput(output);
+
+    recording.reset(new PpuWriteLog());
+    source.setOutput(nullptr);
+    source.writeLog = recording.get();
+    worker = std::thread(&DeferredRenderer::run, this);
+}
+
+DeferredRenderer::~DeferredRenderer() {
+    submit(source.syncedCycle);
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    // The worker's PPU stopped where the source is: the frame it was drawing carries on
+    source.writeLog = nullptr;
+    source.setOutput(output);
+}
+
+void DeferredRenderer::submit(uint64_t cycle) {
+    recording->endCycle = cycle;
+    std::unique_ptr<PpuWriteLog> next;
+    {
+        std::unique_lock<std::mutex> hold(lock);
+        if (pending.size() >= MAX_PENDING) {
+            // Backpressure: the picture never lags emulation by more than MAX_PENDING frames
+            overruns++;
+            room.wait(hold, [this]() { return pending.size() < MAX_PENDING; });
+        }
+        pending.push_back(std::move(recording));
+        if (!spare.empty()) {
+            next = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+    wake.notify_one();
+    recording = next ? std::move(next) : std::unique_ptr<PpuWriteLog>(new PpuWriteLog());
+    source.writeLog = recording.get();
+    framesSubmitted++;
+}
+
+void DeferredRenderer::configure(bool frameElision, bool nametableCache) {
+    recording->config(source.syncedCycle, (frameElision ? 1 : 0) | (nametableCache ? 2 : 0));
+}
+
+void DeferredRenderer::drain() {
+    std::unique_lock<std::mutex> hold(lock);
+    idle.wait(hold, [this]() { return pending.empty() && !busy; });
+}
+
+void DeferredRenderer::run() {
+    std::unique_lock<std::mutex> hold(lock);
+    for (;;) {
+        wake.wait(hold, [this]() { return stopping || !pending.empty(); });
+        if (pending.empty()) return; // Stopping, and everything is rendered
+        std::unique_ptr<PpuWriteLog> log = std::move(pending.front());
+        pending.pop_front();
+        room.notify_one();
+        busy = true;
+        hold.unlock();
+
+        replay(*log);
+        log->clear();
+
+        hold.lock();
+        spare.push_back(std::move(log));
+        busy = false;
+        if (pending.empty()) idle.notify_all();
+    }
+}
+
+void DeferredRenderer::replay(const PpuWriteLog& log) {
+    for (const PpuWriteLog::Entry& entry : log.entries) {
+        ppu.catchUp(entry.cycle);
+        switch (entry.kind) {
+            case PpuWriteLog::Read: ppu.readRegister(entry.addr); break;
+            case PpuWriteLog::Write: ppu.writeRegister(entry.addr, entry.value); break;
+            case PpuWriteLog::Poke: mapper->poke(entry.addr, entry.value); break;
+            case PpuWriteLog::Oam: ppu.writeOam(&log.blobs[entry.blob]); break;
+            case PpuWriteLog::Map: {
+                PpuMapping mapping;
+                memcpy(&mapping, &log.blobs[entry.blob], sizeof(mapping));
+                mapper->remap(mapping);
+                break;
+            }
+            case PpuWriteLog::Config:
+                ppu.frameElision = entry.value & 1;
+                ppu.setNametableCache(entry.value & 2);
+                break;
+        }
+    }
+    ppu.catchUp(log.endCycle);
+}
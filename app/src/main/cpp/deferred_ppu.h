@@ -0,0 +1,119 @@
+/*
+ * Deferred Rendering Module
+ * Responsibility: Move pixel generation off the emulation thread.
+ * In deferred mode the emulation thread's PPU keeps only what the CPU can observe
+ * (position, vblank, sprite 0 hit, overflow, v/t and the rest of its registers) and
+ * draws nothing. Every input it receives - register reads and writes, the memory a
+ * $2007 write changed, OAM DMA, mapper remaps - is logged with the CPU cycle it was
+ * caught up to. A worker thread owns a second PPU, started as an exact copy, with its
+ * own copies of nametable RAM and CHR memory; it replays each frame's log at the same
+ * cycles and publishes the pictures, bit-identical to the inline PPU's.
+ * The emulation thread only appends to the log and hands it over once per frame. It
+ * waits for the worker only when MAX_PENDING logs are already queued (the worker has
+ * fallen that many frames behind); each such wait counts as an overrun.
+ */
+
+#ifndef DEFERRED_PPU_H
+#define DEFERRED_PPU_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "memory_map.h"
+#include "ppu.h"
+#include "rom.h"
+
+class Mapper;
+class ReplayMapper;
+
+// One frame's worth of PPU inputs, in order
+struct PpuWriteLog {
+    enum Kind : uint8_t {
+        Read,   // $2002 / $2007 read (moves w / v)
+        Write,  // Register write
+        Poke,   // $0000-$3EFF after a $2007 write: the byte that is there now
+        Oam,    // OAM DMA: 256 bytes at `blob`
+        Map,    // Mapper remap: a PpuMapping at `blob`
+        Config  // Worker settings: bit 0 frame elision, bit 1 nametable cache
+    };
+    struct Entry {
+        uint64_t cycle;
+        Kind kind;
+        uint8_t value;
+        uint16_t addr;
+        uint32_t blob; // Offset into `blobs`
+    };
+    std::vector<Entry> entries;
+    std::vector<uint8_t> blobs;
+    uint64_t endCycle = 0; // The worker runs its PPU up to here after the last entry
+
+    void read(uint64_t cycle, uint16_t addr) { entries.push_back({cycle, Read, 0, addr, 0}); }
+    void write(uint64_t cycle, uint16_t addr, uint8_t val) { entries.push_back({cycle, Write, val, addr, 0}); }
+    void poke(uint64_t cycle, uint16_t addr, uint8_t val) { entries.push_back({cycle, Poke, val, addr, 0}); }
+    void oam(uint64_t cycle, const uint8_t* data) { entries.push_back({cycle, Oam, 0, 0, append(data, 256)}); }
+    void map(uint64_t cycle, const PpuMapping& mapping) {
+        entries.push_back({cycle, Map, 0, 0, append(&mapping, sizeof(mapping))});
+    }
+    void config(uint64_t cycle, uint8_t settings) { entries.push_back({cycle, Config, settings, 0, 0}); }
+
+    void clear() {
+        entries.clear();
+        blobs.clear();
+    }
+
+private:
+    uint32_t append(const void* data, size_t size) {
+        uint32_t at = (uint32_t)blobs.size();
+        blobs.insert(blobs.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+        return at;
+    }
+};
+
+class DeferredRenderer {
+public:
+    static constexpr size_t MAX_PENDING = 3; // Logs queued for the worker
+
+    // Takes over `emulated`'s output (which it draws nothing into from now on) at its
+    // current cycle. Call between frames, on the emulation thread.
+    DeferredRenderer(PPU& emulated, const Mapper& mapper, const Rom& rom);
+    // Renders everything logged so far, then hands the output back to `source`.
+    ~DeferredRenderer();
+
+    // End of an emulated frame: the log up to `cycle` goes to the worker, after waiting
+    // for room if MAX_PENDING logs are still queued.
+    void submit(uint64_t cycle);
+    // Worker settings follow the emulation thread's, from the current cycle on.
+    void configure(bool frameElision, bool nametableCache);
+    // Blocks until everything submitted has been rendered (tests, teardown).
+    void drain();
+
+    uint32_t framesSubmitted = 0;
+    uint32_t overruns = 0; // Submits that had to wait for the worker
+
+private:
+    PPU& source;
+    FrameQueue* output;
+    Rom rom;                               // Worker's CHR memory
+    std::unique_ptr<ReplayMapper> mapper;  // Worker's nametable RAM and mapping
+    PPU ppu;                               // Worker's PPU
+    std::unique_ptr<PpuWriteLog> recording;
+
+    std::thread worker;
+    std::mutex lock;
+    std::condition_variable wake;          // Work for the worker
+    std::condition_variable idle;          // Worker caught up
+    std::condition_variable room;          // Queue below MAX_PENDING
+    std::deque<std::unique_ptr<PpuWriteLog>> pending;
+    std::vector<std::unique_ptr<PpuWriteLog>> spare;
+    bool busy = false;
+    bool stopping = false;
+
+    void run();
+    void replay(const PpuWriteLog& log);
+};
+
+#endif
@@ -0,0 +1,544 @@
+#include "dynarec.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#include "block_cache.h"
+
+namespace {
+
+using Mode = CPU::AddrMode;
+using Bus = CPU::BusAccess;
+
+// --- Bus Safety ---
+// Native blocks run ahead of the PPU/APU, which are caught up at the block exit.
+// An instruction is only translated when it cannot reach a device register
+// ($2000-$401F) or write a mapper register; cartridge reads have no side effects
+// on the supported boards.
+bool readSafe(uint32_t lo, uint32_t hi) { return hi < 0x2000 || (lo > 0x401F && hi <= 0xFFFF); }
+bool writeSafe(uint32_t lo, uint32_t hi) { return hi < 0x2000 || (lo >= 0x6000 && hi < 0x8000); }
+
+bool accessSafe(Bus access, uint32_t lo, uint32_t hi) {
+    switch (access) {
+        case Bus::Read: return readSafe(lo, hi);
+        case Bus::Write: return writeSafe(lo, hi);
+        case Bus::Modify: return readSafe(lo, hi) && writeSafe(lo, hi);
+        default: return true;
+    }
+}
+
+// Called from native code ahead of (zp,X)/(zp),Y. Returns 0 when the effective
+// address needs the interpreter. Pointers always live in zero page, i.e. plain RAM.
+int guardIndirect(CPU* cpu, uint32_t packed) {
+    uint8_t operand = packed & 0xFF;
+    Mode mode = (Mode)((packed >> 8) & 0xFF);
+    Bus access = (Bus)(packed >> 16);
+    uint16_t ea;
+    if (mode == Mode::IndirectX) {
+        uint8_t zp = operand + cpu->x;
+        ea = cpu->ram[zp] | (cpu->ram[(uint8_t)(zp + 1)] << 8);
+    } else {
+        uint16_t base = cpu->ram[operand] | (cpu->ram[(uint8_t)(operand + 1)] << 8);
+        ea = base + cpu->y;
+    }
+    return accessSafe(access, ea, ea);
+}
+
+enum class Plan { Native, Call, Guarded, Stop };
+
+// How an instruction is translated: inline x86, a call to its interpreter handler,
+// a handler call behind a runtime address guard, or not at all (block ends before it).
+Plan planFor(uint8_t opcode, const CPU::Opcode& op, uint16_t operand) {
+    switch (op.mode) {
+        case Mode::Implied: case Mode::Accumulator: case Mode::Immediate: case Mode::Relative:
+        case Mode::ZeroPage: case Mode::ZeroPageX: case Mode::ZeroPageY:
+            return Plan::Call;
+        case Mode::Absolute:
+            return accessSafe(op.access, operand, operand) ? Plan::Call : Plan::Stop;
+        case Mode::AbsoluteX: case Mode::AbsoluteY:
+            return accessSafe(op.access, operand, operand + 0xFFu) ? Plan::Call : Plan::Stop;
+        case Mode::IndirectX: case Mode::IndirectY:
+            return Plan::Guarded;
+        case Mode::Special:
+            switch (opcode) {
+                case 0x00: case 0x08: case 0x20: case 0x28: case 0x40: // Stack, vectors in ROM
+                case 0x48: case 0x4C: case 0x60: case 0x68:
+                    return Plan::Call;
+                case 0x6C: {
+                    uint16_t hi = (operand & 0xFF00) | ((operand + 1) & 0xFF);
+                    return (readSafe(operand, operand) && readSafe(hi, hi)) ? Plan::Call : Plan::Stop;
+                }
+                default:
+                    return BlockCache::endsBlock(opcode) ? Plan::Call : Plan::Stop; // JAM runs, SH*/TAS don't
+            }
+    }
+    return Plan::Stop;
+}
+
+// Built once at load and read-only after, so a benchmark Dynarec may run beside the emulation one
+struct ZnFlagTable {
+    uint8_t flags[256];
+    ZnFlagTable() {
+        for (int v = 0; v < 256; v++) flags[v] = v == 0 ? 0x02 : (v & 0x80);
+    }
+    uint8_t operator[](int v) const { return flags[v]; }
+};
+const ZnFlagTable ZN_FLAGS;
+
+const int32_t OFF_A = offsetof(CPU, a);
+const int32_t OFF_X = offsetof(CPU, x);
+const int32_t OFF_Y = offsetof(CPU, y);
+const int32_t OFF_SP = offsetof(CPU, sp);
+const int32_t OFF_PC = offsetof(CPU, pc);
+const int32_t OFF_STATUS = offsetof(CPU, status);
+const int32_t OFF_RAM = offsetof(CPU, ram);
+const int32_t OFF_PAGE_FLAGS = offsetof(CPU, pages) + offsetof(CpuPageTable, flags);
+
+} // namespace
+
+// --- x86-64 Emitter ---
+// Register use inside a block: rbx = CPU*, r12d = cycles returned by handlers,
+// r13 = ZN_FLAGS, r14d = cycle budget. All callee-saved, so handler calls need no spills.
+// 6502 registers stay in the CPU struct and are addressed as [rbx + disp32].
+struct Emitter {
+    uint8_t* p;
+    uint8_t* end;
+
+    bool overflowed() const { return p > end; }
+    void byte(uint8_t b) { if (p < end) *p = b; p++; }
+    void u16(uint16_t v) { byte(v & 0xFF); byte(v >> 8); }
+    void u32(uint32_t v) { for (int i = 0; i < 4; i++) byte(v >> (8 * i)); }
+    void u64(uint64_t v) { for (int i = 0; i < 8; i++) byte(v >> (8 * i)); }
+    void mem(uint8_t reg, int32_t disp) { byte(0x80 | (reg << 3) | 3); u32(disp); } // [rbx + disp32]
+
+    void prologue() {
+        byte(0x53);                               // push rbx
+        byte(0x41); byte(0x54);                   // push r12
+        byte(0x41); byte(0x55);                   // push r13
+        byte(0x41); byte(0x56);                   // push r14
+        byte(0x48); byte(0x83); byte(0xEC); byte(0x08); // sub rsp, 8 (calls need rsp 16-aligned)
+        byte(0x48); byte(0x89); byte(0xFB);       // mov rbx, rdi
+        byte(0x41); byte(0x89); byte(0xF6);       // mov r14d, esi
+        byte(0x45); byte(0x31); byte(0xE4);       // xor r12d, r12d
+        byte(0x49); byte(0xBD); u64((uintptr_t)ZN_FLAGS.flags); // mov r13, ZN_FLAGS
+    }
+    void exit(uint32_t staticCycles) {
+        byte(0x44); byte(0x89); byte(0xE0);       // mov eax, r12d
+        byte(0x05); u32(staticCycles);            // add eax, imm32
+        byte(0x48); byte(0x83); byte(0xC4); byte(0x08); // add rsp, 8
+        byte(0x41); byte(0x5E);                   // pop r14
+        byte(0x41); byte(0x5D);                   // pop r13
+        byte(0x41); byte(0x5C);                   // pop r12
+        byte(0x5B);                               // pop rbx
+        byte(0xC3);                               // ret
+    }
+
+    void load(int32_t field) { byte(0x0F); byte(0xB6); mem(0, field); }        // movzx eax, byte [field]
+    void store(int32_t field) { byte(0x88); mem(0, field); }                    // mov [field], al
+    void storeImm(int32_t field, uint8_t v) { byte(0xC6); mem(0, field); byte(v); }
+    void andImm(int32_t field, uint8_t v) { byte(0x80); mem(4, field); byte(v); }
+    void orImm(int32_t field, uint8_t v) { byte(0x80); mem(1, field); byte(v); }
+    void testImm(int32_t field, uint8_t v) { byte(0xF6); mem(0, field); byte(v); }
+    void inc(int32_t field) { byte(0xFE); mem(0, field); }
+    void dec(int32_t field) { byte(0xFE); mem(1, field); }
+    void setPc(uint16_t pc) { byte(0x66); byte(0xC7); mem(0, OFF_PC); u16(pc); }
+
+    // N/Z from the value in eax (zero-extended)
+    void setZN() {
+        andImm(OFF_STATUS, 0x7D);
+        byte(0x41); byte(0x8A); byte(0x44); byte(0x05); byte(0x00); // mov al, [r13 + rax]
+        byte(0x08); mem(0, OFF_STATUS);                              // or [status], al
+    }
+    void setZNConst(uint8_t v) {
+        andImm(OFF_STATUS, 0x7D);
+        if (ZN_FLAGS[v]) orImm(OFF_STATUS, ZN_FLAGS[v]);
+    }
+
+    void call(const void* fn, bool hasArg = false, uint32_t arg = 0) {
+        byte(0x48); byte(0x89); byte(0xDF);       // mov rdi, rbx
+        if (hasArg) { byte(0xBE); u32(arg); }     // mov esi, imm32
+        byte(0x48); byte(0xB8); u64((uintptr_t)fn); // mov rax, fn
+        byte(0xFF); byte(0xD0);                   // call rax
+    }
+    void addHandlerCycles() { byte(0x41); byte(0x01); byte(0xC4); } // add r12d, eax
+
+    // Forward jumps: returns the rel32 slot to patch with bind()
+    uint8_t* jcc(uint8_t cc) { byte(0x0F); byte(0x80 | cc); uint8_t* at = p; u32(0); return at; }
+    uint8_t* jmp() { byte(0xE9); uint8_t* at = p; u32(0); return at; }
+    void bind(uint8_t* at) {
+        if (p > end) return;
+        int32_t rel = (int32_t)(p - (at + 4));
+        memcpy(at, &rel, 4);
+    }
+    void testEax() { byte(0x85); byte(0xC0); }
+    // Flags of (cycles so far - budget)
+    void compareBudget(uint32_t staticCycles) {
+        byte(0x41); byte(0x8D); byte(0x84); byte(0x24); u32(staticCycles); // lea eax, [r12 + imm32]
+        byte(0x44); byte(0x39); byte(0xF0);                                // cmp eax, r14d
+    }
+    void testFlag(const bool* flag) {
+        byte(0x48); byte(0xB8); u64((uintptr_t)flag); // mov rax, flag
+        byte(0x80); byte(0x38); byte(0x00);           // cmp byte [rax], 0
+    }
+};
+
+namespace {
+constexpr uint8_t CC_Z = 0x4, CC_NZ = 0x5, CC_L = 0xC;
+
+// CLI and PLP can unmask a pending IRQ, which the interpreter takes right after them
+bool unmasksIrq(uint8_t opcode) { return opcode == 0x58 || opcode == 0x28; }
+
+int32_t regField(uint8_t opcode) {
+    // Loads/stores/transfers name their register in the low two bits: 0 = Y, 1 = A, 2 = X
+    switch (opcode & 0x03) {
+        case 0: return OFF_Y;
+        case 2: return OFF_X;
+        default: return OFF_A;
+    }
+}
+} // namespace
+
+bool Dynarec::supported() { return true; }
+
+Dynarec::Dynarec(CPU& target, bool lockstepMode) : cpu(target), lockstep(lockstepMode) {
+    void* mem = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) {
+        NESO_LOGD("Dynarec: executable memory unavailable, staying on the interpreter");
+    } else {
+        code = (uint8_t*)mem;
+    }
+    if (lockstep) {
+        shadow.reset(new CPU());
+        shadow->idleSkip = false; // Must retrace every instruction the native code ran
+    }
+}
+
+Dynarec::~Dynarec() {
+    if (code) munmap(code, CODE_SIZE);
+}
+
+void Dynarec::flush() {
+    blocks.clear();
+    visits.clear();
+    ramBlocks.clear();
+    std::fill(&fast[0], &fast[FAST_SLOTS], nullptr);
+    codeUsed = 0;
+}
+
+int Dynarec::run(int cycleBudget) {
+    if (!code) return 0;
+    int page = CpuPageTable::page(cpu.pc);
+    const uint8_t* base = cpu.pages.read[page];
+    if (!base) return 0;
+
+    const uint8_t* host = base + (cpu.pc & CpuPageTable::PAGE_MASK);
+    uint64_t k = key(host, cpu.pc);
+    NativeBlock*& cached = fast[k % FAST_SLOTS];
+    NativeBlock* b = cached;
+    if (!b || b->source != host || b->pc != cpu.pc) {
+        auto it = blocks.find(k);
+        if (it != blocks.end()) {
+            b = it->second.get();
+        } else {
+            if (++visits[k] < HOT_THRESHOLD) return 0;
+            visits.erase(k);
+            b = compile(host, page, cpu.pc & CpuPageTable::PAGE_MASK);
+            if (!b) return 0;
+        }
+        cached = b;
+    }
+    if (!b->code) return 0;
+
+    if (lockstep) {
+        if (cpu.totalCycles != exitCycles) {
+            syncShadow();
+        } else {
+            // Straight from the previous block: the shadow carries on from where it is
+            compareShadow();
+            compareCycles();
+        }
+        shadowCycles = 0;
+        budget = cycleBudget;
+    }
+    aborted = false;
+    int cycles = b->code(&cpu, cycleBudget);
+    if (lockstep) {
+        exitCycles = cpu.totalCycles + cycles;
+        if ((uint64_t)cycles != shadowCycles) {
+            lockstepMismatches++;
+            NESO_LOGD("Dynarec lockstep: block $%04X took %d cycles, interpreter %llu",
+                      b->pc, cycles, (unsigned long long)shadowCycles);
+        }
+        compareMemory();
+    }
+    return cycles;
+}
+
+NativeBlock* Dynarec::compile(const uint8_t* host, int page, uint16_t offset) {
+    if (CODE_SIZE - codeUsed < 8192) flush();
+
+    std::unique_ptr<NativeBlock> b(new NativeBlock());
+    b->source = host;
+    b->pc = cpu.pc;
+    b->fromRam = cpu.pages.writable[page] != nullptr;
+
+    const uint8_t* base = cpu.pages.read[page];
+    Emitter e = { code + codeUsed, code + CODE_SIZE };
+    e.prologue();
+
+    uint32_t off = offset;
+    uint16_t pc = cpu.pc;
+    uint32_t staticCycles = 0;
+    int count = 0;
+    bool ended = false;
+    while (count < MAX_BLOCK_OPS) {
+        uint8_t opcode = base[off];
+        const CPU::Opcode& op = CPU::OPCODES[opcode];
+        if (off + op.bytes > (uint32_t)CpuPageTable::PAGE_SIZE) break;
+        uint16_t operand = 0;
+        if (op.bytes > 1) {
+            operand = base[off + 1];
+            if (op.bytes > 2) operand |= base[off + 2] << 8;
+        }
+        Plan plan = planFor(opcode, op, operand);
+        if (plan == Plan::Stop) break;
+
+        if (count > 0) {
+            // The interpreter starts no instruction at or past the next event
+            e.compareBudget(staticCycles);
+            uint8_t* inBudget = e.jcc(CC_L);
+            e.setPc(pc);
+            e.exit(staticCycles);
+            e.bind(inBudget);
+        }
+
+        uint16_t next = pc + op.bytes;
+        if (plan == Plan::Guarded) {
+            e.call((const void*)&guardIndirect, true, operand | ((uint32_t)op.mode << 8) | ((uint32_t)op.access << 16));
+            e.testEax();
+            uint8_t* ok = e.jcc(CC_NZ);
+            e.setPc(pc);
+            e.exit(staticCycles);
+            e.bind(ok);
+        }
+        staticCycles += op.cycles;
+
+        bool native = true;
+        bool ramStore = (opcode == 0x84 || opcode == 0x85 || opcode == 0x86 ||
+                         ((opcode == 0x8C || opcode == 0x8D || opcode == 0x8E) && operand < 0x2000));
+        switch (opcode) {
+            case 0x18: e.andImm(OFF_STATUS, 0xFE); break; // CLC
+            case 0x38: e.orImm(OFF_STATUS, 0x01); break;  // SEC
+            case 0x58: e.andImm(OFF_STATUS, 0xFB); break; // CLI
+            case 0x78: e.orImm(OFF_STATUS, 0x04); break;  // SEI
+            case 0xB8: e.andImm(OFF_STATUS, 0xBF); break; // CLV
+            case 0xD8: e.andImm(OFF_STATUS, 0xF7); break; // CLD
+            case 0xF8: e.orImm(OFF_STATUS, 0x08); break;  // SED
+            case 0xEA: break;                             // NOP
+            case 0xE8: e.inc(OFF_X); e.load(OFF_X); e.setZN(); break; // INX
+            case 0xC8: e.inc(OFF_Y); e.load(OFF_Y); e.setZN(); break; // INY
+            case 0xCA: e.dec(OFF_X); e.load(OFF_X); e.setZN(); break; // DEX
+            case 0x88: e.dec(OFF_Y); e.load(OFF_Y); e.setZN(); break; // DEY
+            case 0xAA: e.load(OFF_A); e.store(OFF_X); e.setZN(); break; // TAX
+            case 0xA8: e.load(OFF_A); e.store(OFF_Y); e.setZN(); break; // TAY
+            case 0x8A: e.load(OFF_X); e.store(OFF_A); e.setZN(); break; // TXA
+            case 0x98: e.load(OFF_Y); e.store(OFF_A); e.setZN(); break; // TYA
+            case 0xBA: e.load(OFF_SP); e.store(OFF_X); e.setZN(); break; // TSX
+            case 0x9A: e.load(OFF_X); e.store(OFF_SP); break;           // TXS
+            case 0xA0: case 0xA2: case 0xA9:                            // LDY/LDX/LDA #imm
+                e.storeImm(regField(opcode), (uint8_t)operand);
+                e.setZNConst((uint8_t)operand);
+                break;
+            case 0xA4: case 0xA5: case 0xA6:                            // LDY/LDA/LDX zp
+                e.load(OFF_RAM + operand);
+                e.store(regField(opcode));
+                e.setZN();
+                break;
+            case 0xAC: case 0xAD: case 0xAE:                            // LDY/LDA/LDX abs (RAM)
+                if (operand >= 0x2000) { native = false; break; }
+                e.load(OFF_RAM + (operand & 0x7FF));
+                e.store(regField(opcode));
+                e.setZN();
+                break;
+            default:
+                native = false;
+                break;
+        }
+
+        if (ramStore && !b->fromRam) {
+            // STY/STA/STX into RAM: direct unless the page holds cached code
+            uint16_t addr = operand & 0x7FF;
+            e.testImm(OFF_PAGE_FLAGS + CpuPageTable::page(operand), CpuPageTable::WATCH_CODE);
+            uint8_t* slow = e.jcc(CC_NZ);
+            e.load(regField(opcode));
+            e.store(OFF_RAM + addr);
+            uint8_t* done = e.jmp();
+            e.bind(slow);
+            e.setPc(next);
+            e.call((const void*)op.execute, true, operand);
+            e.bind(done);
+            native = true;
+        }
+
+        if (op.mode == Mode::Relative) {
+            static const uint8_t BRANCH_FLAGS[4] = { 0x80, 0x40, 0x01, 0x02 }; // BPL/BMI, BVC/BVS, BCC/BCS, BNE/BEQ
+            uint8_t flag = BRANCH_FLAGS[opcode >> 6];
+            bool set = (opcode >> 5) & 1;
+            uint16_t target = next + (int8_t)operand;
+            e.testImm(OFF_STATUS, flag);
+            uint8_t* notTaken = e.jcc(set ? CC_Z : CC_NZ);
+            e.setPc(target);
+            if (lockstep) e.call((const void*)&Dynarec::lockstepStep);
+            e.exit(staticCycles + 1 + (((next ^ target) & 0xFF00) ? 1 : 0));
+            e.bind(notTaken);
+        } else if (!native) {
+            e.setPc(next);
+            e.call((const void*)op.execute, true, operand);
+            e.addHandlerCycles();
+        }
+
+        count++;
+        pc = next;
+        off += op.bytes;
+        ended = BlockCache::endsBlock(opcode) || unmasksIrq(opcode);
+
+        if (lockstep) {
+            if (!ended) e.setPc(pc);
+            e.call((const void*)&Dynarec::lockstepStep);
+        }
+        if (ended) break;
+        if (b->fromRam && !native && op.mode != Mode::Relative) {
+            // The handler may have overwritten this very block
+            e.testFlag(&aborted);
+            uint8_t* intact = e.jcc(CC_Z);
+            e.setPc(pc);
+            e.exit(staticCycles);
+            e.bind(intact);
+        }
+    }
+    b->length = (uint16_t)(off - offset);
+
+    if (count == 0) {
+        // First instruction needs the interpreter: remember that, not worth a retry
+        b->length = CPU::OPCODES[base[offset]].bytes;
+    } else {
+        if (!ended) e.setPc(pc);
+        e.exit(staticCycles);
+        if (e.overflowed()) {
+            flush();
+            return nullptr;
+        }
+        b->code = (int (*)(CPU*, int))(code + codeUsed);
+        codeUsed = (e.p - code + 15) & ~(size_t)15;
+        blocksCompiled++;
+    }
+
+    NativeBlock* raw = b.get();
+    if (raw->fromRam) {
+        ramBlocks.push_back(raw);
+        cpu.pages.watchCode(page);
+    }
+    blocks[key(host, raw->pc)] = std::move(b);
+    return raw;
+}
+
+void Dynarec::invalidate(const uint8_t* host) {
+    for (size_t i = 0; i < ramBlocks.size(); ) {
+        NativeBlock* b = ramBlocks[i];
+        if (host < b->source || host >= b->source + b->length) { i++; continue; }
+
+        aborted = true;
+        uint64_t k = key(b->source, b->pc);
+        if (fast[k % FAST_SLOTS] == b) fast[k % FAST_SLOTS] = nullptr;
+        ramBlocks[i] = ramBlocks.back();
+        ramBlocks.pop_back();
+        blocks.erase(k); // Code bytes stay in the buffer until the next flush
+        blocksInvalidated++;
+    }
+}
+
+// --- Lockstep ---
+// The shadow CPU gets private copies of RAM and PRG-RAM and no devices, is synced at
+// the entry of a block the interpreter ran anything before, and then interprets one
+// instruction per translated instruction, on its own clock.
+
+namespace {
+uint8_t shadowRead(CPU&, uint16_t) { return 0; }
+void shadowWrite(CPU&, uint16_t, uint8_t) {}
+}
+
+void Dynarec::syncShadow() {
+    CPU& s = *shadow;
+    s.a = cpu.a; s.x = cpu.x; s.y = cpu.y; s.sp = cpu.sp; s.pc = cpu.pc; s.status = cpu.status;
+    s.totalCycles = cpu.totalCycles;
+    memcpy(s.ram, cpu.ram, sizeof(s.ram));
+    s.pages = cpu.pages;
+    for (int p = 0; p < CpuPageTable::PAGE_COUNT; p++) {
+        s.pages.flags[p] = 0;
+        s.pages.ioRead[p] = shadowRead;
+        s.pages.ioWrite[p] = shadowWrite;
+        if (cpu.pages.read[p] == cpu.ram) {
+            s.pages.read[p] = s.pages.writable[p] = s.ram;
+        } else if (cpu.pages.writable[p]) {
+            memcpy(shadowPrgRam[p], cpu.pages.writable[p], CpuPageTable::PAGE_SIZE);
+            s.pages.read[p] = s.pages.writable[p] = shadowPrgRam[p];
+        }
+        s.pages.refresh(p);
+    }
+}
+
+void Dynarec::lockstepStep(CPU* target) {
+    Dynarec& d = *target->dynarec;
+    if (d.shadowCycles >= (uint64_t)d.budget) {
+        d.lockstepMismatches++;
+        NESO_LOGD("Dynarec lockstep: PC=%04X ran %llu cycles into a block with a budget of %d",
+                  d.shadow->pc, (unsigned long long)d.shadowCycles, d.budget);
+    }
+    d.shadowCycles += d.shadow->step();
+    d.lockstepChecks++;
+    d.compareShadow();
+}
+
+void Dynarec::compareShadow() {
+    CPU& s = *shadow;
+    if (s.a == cpu.a && s.x == cpu.x && s.y == cpu.y && s.sp == cpu.sp && s.pc == cpu.pc && s.status == cpu.status) return;
+    lockstepMismatches++;
+    NESO_LOGD("Dynarec lockstep: native A=%02X X=%02X Y=%02X SP=%02X P=%02X PC=%04X | interpreter A=%02X X=%02X Y=%02X SP=%02X P=%02X PC=%04X",
+              cpu.a, cpu.x, cpu.y, cpu.sp, cpu.status, cpu.pc, s.a, s.x, s.y, s.sp, s.status, s.pc);
+    s.a = cpu.a; s.x = cpu.x; s.y = cpu.y; s.sp = cpu.sp; s.pc = cpu.pc; s.status = cpu.status;
+}
+
+void Dynarec::compareCycles() {
+    if (shadow->totalCycles == cpu.totalCycles) return;
+    lockstepMismatches++;
+    NESO_LOGD("Dynarec lockstep: native at cycle %llu, interpreter at %llu",
+              (unsigned long long)cpu.totalCycles, (unsigned long long)shadow->totalCycles);
+    shadow->totalCycles = cpu.totalCycles;
+}
+
+void Dynarec::compareMemory() {
+    CPU& s = *shadow;
+    bool same = memcmp(s.ram, cpu.ram, sizeof(s.ram)) == 0;
+    for (int p = 0; p < CpuPageTable::PAGE_COUNT && same; p++) {
+        if (cpu.pages.writable[p] && cpu.pages.read[p] != cpu.ram) {
+            same = memcmp(shadowPrgRam[p], cpu.pages.writable[p], CpuPageTable::PAGE_SIZE) == 0;
+        }
+    }
+    if (!same) {
+        lockstepMismatches++;
+        NESO_LOGD("Dynarec lockstep: memory differs after block ending at PC=%04X", cpu.pc);
+    }
+}
+
+#else // !__x86_64__
+
+bool Dynarec::supported() { return false; }
+Dynarec::Dynarec(CPU& target, bool lockstepMode) : cpu(target), lockstep(lockstepMode) {}
+Dynarec::~Dynarec() {}
+int Dynarec::run(int) { return 0; }
+void Dynarec::invalidate(const uint8_t*) {}
+void Dynarec::flush() {}
+
+#endif
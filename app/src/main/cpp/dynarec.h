@@ -0,0 +1,86 @@
+/*
+ * Dynarec Module (x86-64)
+ * Responsibility: Translate hot 6502 runs into native code for bulk/headless runs.
+ * The interpreter stays the reference: anything that may touch I/O or mapper
+ * registers exits the native block first, a block leaves at the first instruction
+ * boundary past its cycle budget (the next event) and after anything that can
+ * unmask IRQs, so events and interrupts land on the same instruction as when
+ * interpreted. Lockstep mode re-executes every translated instruction on a shadow
+ * CPU and compares register state and cycle count.
+ * On other architectures the class compiles to a stub and supported() is false.
+ */
+
+#ifndef DYNAREC_H
+#define DYNAREC_H
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "cpu.h"
+
+struct NativeBlock {
+    int (*code)(CPU* cpu, int budget) = nullptr; // Returns cycles; null = not translatable, stay interpreted
+    const uint8_t* source = nullptr;  // Host address of the first opcode byte
+    uint16_t pc = 0;                  // Native code embeds absolute PCs, so mirrors get their own block
+    uint16_t length = 0;              // Bytes covered
+    bool fromRam = false;
+};
+
+class Dynarec {
+public:
+    static bool supported();
+
+    Dynarec(CPU& cpu, bool lockstep);
+    ~Dynarec();
+
+    // Runs the native block at cpu.pc, starting no instruction once `budget` cycles
+    // have passed. Returns the cycles it took, or 0 when the interpreter has to
+    // execute the next instruction itself.
+    int run(int budget);
+
+    void invalidate(const uint8_t* host); // A byte in a WATCH_CODE page was written
+    void flush();
+
+    // Telemetry
+    uint64_t blocksCompiled = 0;
+    uint64_t blocksInvalidated = 0;
+    uint64_t lockstepChecks = 0;
+    uint64_t lockstepMismatches = 0;
+
+private:
+    static constexpr int HOT_THRESHOLD = 8;      // Interpreted visits before a run is translated
+    static constexpr int MAX_BLOCK_OPS = 32;
+    static constexpr size_t CODE_SIZE = 4 << 20; // Flushed wholesale when full
+    static constexpr int FAST_SLOTS = 1024;
+
+    static uint64_t key(const uint8_t* host, uint16_t pc) { return ((uint64_t)(uintptr_t)host << 16) | pc; }
+    NativeBlock* compile(const uint8_t* host, int page, uint16_t offset);
+
+    // Lockstep
+    static void lockstepStep(CPU* cpu);
+    void syncShadow();
+    void compareShadow();
+    void compareCycles();
+    void compareMemory();
+
+    CPU& cpu;
+    bool lockstep;
+    uint8_t* code = nullptr;
+    size_t codeUsed = 0;
+    std::unordered_map<uint64_t, std::unique_ptr<NativeBlock>> blocks;
+    std::unordered_map<uint64_t, int> visits;
+    std::vector<NativeBlock*> ramBlocks;
+    NativeBlock* fast[FAST_SLOTS] = {nullptr}; // Direct-mapped front of `blocks`
+    bool aborted = false; // Set when the running block's own code is overwritten
+
+    // The shadow keeps its own timeline across consecutive blocks and is only synced
+    // again once the interpreter has run something (exitCycles no longer matches).
+    std::unique_ptr<CPU> shadow;
+    uint8_t shadowPrgRam[CpuPageTable::PAGE_COUNT][CpuPageTable::PAGE_SIZE];
+    uint64_t shadowCycles = 0; // Into the running block
+    uint64_t exitCycles = ~0ULL; // cpu.totalCycles right after the last native block
+    int budget = 0;
+};
+
+#endif
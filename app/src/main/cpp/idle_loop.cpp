@@ -0,0 +1,125 @@
+#include "idle_loop.h"
+#include "cpu.h"
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// Reads the loop may make without side effects beyond PPUSTATUS' own (idempotent
+// after the first pass): anything the page table maps directly, or $2002.
+bool pollable(const CPU& cpu, uint16_t addr, bool& readsStatus) {
+    if (addr >= 0x2000 && addr < 0x4000 && (addr & 0x0007) == 0x0002) {
+        readsStatus = true;
+        return true;
+    }
+    return cpu.pages.read[CpuPageTable::page(addr)] != nullptr;
+}
+
+} // namespace
+
+void IdleLoop::backEdge(const CPU& cpu) {
+    if (cpu.pc == start && cpu.pages.generation == generation) return;
+    start = cpu.pc;
+    generation = cpu.pages.generation;
+    armed = false;
+    quietUntil = 0;
+    valid = analyze(cpu);
+}
+
+// Walks the bytes from the head to a branch or JMP back onto it. Anything else that
+// moves pc, touches the stack or writes the bus disqualifies the loop.
+bool IdleLoop::analyze(const CPU& cpu) {
+    using Mode = CPU::AddrMode;
+    const uint16_t head = cpu.pc;
+    const int page = CpuPageTable::page(head);
+    const uint8_t* base = cpu.pages.read[page];
+    if (!base) return false;
+
+    uint32_t off = head & CpuPageTable::PAGE_MASK;
+    bool pollsStatus = false;
+    int cycles = 0;
+    for (uint16_t at = head; ; ) {
+        uint8_t opcode = base[off];
+        const CPU::Opcode& op = CPU::OPCODES[opcode];
+        if (off + op.bytes > (uint32_t)CpuPageTable::PAGE_SIZE) return false;
+
+        uint16_t operand = 0;
+        if (op.bytes > 1) {
+            operand = base[off + 1];
+            if (op.bytes > 2) operand |= base[off + 2] << 8;
+        }
+
+        if (opcode == 0x4C) { // JMP abs
+            if (operand != head) return false;
+            cycles += op.cycles;
+            break;
+        }
+        if (op.mode == Mode::Relative) {
+            uint16_t next = at + 2;
+            uint16_t target = next + (int8_t)operand;
+            if (target != head) return false; // Only the closing branch may be conditional
+            cycles += op.cycles + 1 + ((next & 0xFF00) != (target & 0xFF00));
+            break;
+        }
+        if (op.mode == Mode::Special) return false;
+
+        if (op.access == CPU::BusAccess::Read) {
+            if (op.mode == Mode::ZeroPage) {
+                if (!pollable(cpu, operand & 0xFF, pollsStatus)) return false;
+            } else if (op.mode == Mode::Absolute) {
+                if (!pollable(cpu, operand, pollsStatus)) return false;
+            } else if (op.mode != Mode::Immediate) {
+                return false; // Indexed: the address depends on registers mid-body
+            }
+        } else if (op.access != CPU::BusAccess::None) {
+            return false;
+        }
+
+        cycles += op.cycles;
+        off += op.bytes;
+        at += op.bytes;
+        if ((uint16_t)(at - head) > MAX_BODY) return false;
+    }
+
+    readsStatus = pollsStatus;
+    iterationCycles = cycles;
+    return true;
+}
+
+int IdleLoop::arrive(const CPU& cpu) {
+    if (cpu.pages.generation != generation) {
+        reset(); // Banks moved under the body; the next back edge re-analyzes
+        return 0;
+    }
+    if (!valid) return 0;
+
+    uint64_t now = cpu.totalCycles;
+    bool settled = armed && now - arrivedAt == (uint64_t)iterationCycles &&
+                   cpu.a == a && cpu.x == x && cpu.y == y && cpu.sp == sp && cpu.status == status;
+    arrivedAt = now;
+    if (!settled) {
+        a = cpu.a; x = cpu.x; y = cpu.y; sp = cpu.sp; status = cpu.status;
+        armed = true;
+        return 0;
+    }
+    if (now < quietUntil) return 0;
+
+    int skip = std::min(cyclesUntilEvent(cpu), cpu.skipLimit);
+    skip -= skip % iterationCycles;
+    if (skip <= 0) {
+        quietUntil = now + BACKOFF_ITERATIONS * iterationCycles;
+        return 0;
+    }
+    // The pass after the jump counts as settled as well
+    arrivedAt = now + skip - iterationCycles;
+    return skip;
+}
+
+// CPU cycles that can elapse before the loop could observe a difference. Interrupts
+// are scheduled events and already cap the jump through skipLimit; PPUSTATUS flips
+// are not, so a loop polling it stops short of the next one and sees it interpreted.
+int IdleLoop::cyclesUntilEvent(const CPU& cpu) const {
+    if (!readsStatus || !cpu.ppu) return INT_MAX;
+    cpu.ppu->catchUp(cpu.totalCycles);
+    return (cpu.ppu->dotsUntilStatusChange() - 1) / 3;
+}
@@ -0,0 +1,43 @@
+/*
+ * Idle Loop Module
+ * Responsibility: Spot polling loops (LDA $2002 / BPL, LDA flag / BEQ, JMP *) and
+ * let the CPU jump whole iterations ahead to the next PPU/APU event.
+ * A loop qualifies when its body is straight-line code that only reads RAM, ROM or
+ * PPUSTATUS and two passes in a row start from the same registers: from then on
+ * only an interrupt or a PPUSTATUS change can make it do anything different.
+ */
+
+#ifndef IDLE_LOOP_H
+#define IDLE_LOOP_H
+
+#include <cstdint>
+
+struct CPU;
+
+struct IdleLoop {
+    static constexpr int MAX_BODY = 16;          // Bytes from loop head to the closing branch
+    static constexpr int BACKOFF_ITERATIONS = 4; // Passes to run normally when an event is too close
+
+    // Loop under watch
+    int start = -1;             // Head address, -1 = none
+    bool valid = false;         // Body passed analyze()
+    bool readsStatus = false;   // Polls $2002 (or a mirror)
+    int iterationCycles = 0;    // Exact cost of one pass, closing branch taken
+    uint32_t generation = 0;    // Page table generation the body was analyzed against
+
+    // Last pass through the head
+    bool armed = false;
+    uint8_t a = 0, x = 0, y = 0, sp = 0, status = 0;
+    uint64_t arrivedAt = 0;
+    uint64_t quietUntil = 0;
+
+    void backEdge(const CPU& cpu); // pc just moved backwards (or onto itself)
+    int arrive(const CPU& cpu);    // pc is at the head: cycles to fast-forward, 0 = execute normally
+    void reset() { start = -1; armed = false; }
+
+private:
+    bool analyze(const CPU& cpu);
+    int cyclesUntilEvent(const CPU& cpu) const;
+};
+
+#endif
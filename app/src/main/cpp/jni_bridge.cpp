@@ -11,25 +11,43 @@
 #include "rom.h"
 #include "mapper.h"
 #include "renderer.h"
+#ifdef NESO_BENCHMARKS
+#include "benchmark.h"
+#endif
+#include "scheduler.h"
+#include "video_output.h"
+#include "deferred_ppu.h"
 #include <cstring>
+#include <memory>
+#include <atomic>
+#include <thread>
 #include <android/log.h>
 #define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, "NesoJNI", __VA_ARGS__)
 #define LOGW(...) __android_log_print(ANDROID_LOG_WARN,  "NesoJNI", __VA_ARGS__)
 
+static constexpr int CYCLES_PER_FRAME = 29780; // Authentic NTSC cycles per frame
+
 struct NesoSystem {
-    uint32_t screenBuffer[SCREEN_WIDTH * SCREEN_HEIGHT] = {0};
+    FrameQueue screen;                 // PPU -> renderFrame, lock-free
+    DisplayPalette palette;            // Emphasis x palette index -> output pixel
+    uint32_t presentedFrame = 0;       // Sequence and palette version last converted
+    uint32_t presentedPalette = 0;
     CPU* cpu = nullptr;
     PPU ppu;
     APU apu;
+    Scheduler scheduler;
     Rom* rom = nullptr;
     Mapper* mapper = nullptr;
+    std::unique_ptr<DeferredRenderer> deferred; // Pixels drawn on a worker thread, when set
 
     // Telemetry
     uint16_t lastPC = 0;
     int stagnantFrames = 0;
     int frameCounter = 0;
+    uint32_t idleCyclesLastFrame = 0; // Cycles the CPU fast-forwarded through polling loops
 
     ~NesoSystem() {
+        deferred.reset();
         if (cpu) delete cpu;
         if (rom) delete rom;
         if (mapper) delete mapper;
@@ -38,6 +56,16 @@ struct NesoSystem {
 
 static NesoSystem* systemGlobal = nullptr;
 
+// Restarts the timeline at the CPU's current cycle (after a reset): devices realign
+// and post their first events.
+static void startTimeline(NesoSystem& sys) {
+    uint64_t now = sys.cpu->totalCycles;
+    sys.scheduler.reset();
+    sys.scheduler.schedule(Event::FrameEnd, now + CYCLES_PER_FRAME);
+    sys.ppu.catchUp(now);
+    sys.apu.catchUp(now);
+}
+
 extern "C" {
 
 JNIEXPORT jlong JNICALL
@@ -51,10 +79,15 @@ Java_com_neso_core_MainActivity_createCpu(JNIEnv* env, jobject thiz) {
     systemGlobal->cpu->reset();
     
     systemGlobal->ppu.reset();
-    systemGlobal->ppu.pixelBuffer = systemGlobal->screenBuffer;
+    systemGlobal->ppu.frames = &systemGlobal->screen;
+    systemGlobal->ppu.cpu = systemGlobal->cpu;
+    systemGlobal->ppu.scheduler = &systemGlobal->scheduler;
     
     systemGlobal->apu.cpu = systemGlobal->cpu;
+    systemGlobal->apu.scheduler = &systemGlobal->scheduler;
     systemGlobal->apu.reset();
+
+    startTimeline(*systemGlobal);
     
     return (jlong)systemGlobal->cpu;
 }
@@ -65,6 +98,9 @@ Java_com_neso_core_MainActivity_loadRom(JNIEnv* env, jobject thiz, jbyteArray da
     jsize len = env->GetArrayLength(data);
     jbyte* buf = env->GetByteArrayElements(data, 0);
 
+    // The worker holds copies of the old cartridge: start it again on the new one
+    bool deferred = systemGlobal->deferred != nullptr;
+    systemGlobal->deferred.reset();
     if (systemGlobal->rom) delete systemGlobal->rom;
     if (systemGlobal->mapper) delete systemGlobal->mapper;
 
@@ -82,8 +118,13 @@ Java_com_neso_core_MainActivity_loadRom(JNIEnv* env, jobject thiz, jbyteArray da
         }
         systemGlobal->cpu->mapper = systemGlobal->mapper;
         systemGlobal->ppu.mapper = systemGlobal->mapper;
+        systemGlobal->mapper->attachPpu(&systemGlobal->ppu);
         LOGD("Mapper %d initialized, resetting CPU...", mapperId);
         systemGlobal->cpu->reset();
+        startTimeline(*systemGlobal);
+        if (deferred) {
+            systemGlobal->deferred.reset(new DeferredRenderer(systemGlobal->ppu, *systemGlobal->mapper, *systemGlobal->rom));
+        }
         
         // --- Vector Verification ---
         uint8_t lo = systemGlobal->cpu->read(0xFFFC);
@@ -107,23 +148,29 @@ Java_com_neso_core_MainActivity_loadRom(JNIEnv* env, jobject thiz, jbyteArray da
         if (!systemGlobal || !systemGlobal->cpu || !systemGlobal->mapper) return;
         
         // --- Core Execution Loop ---
-        int cyclesThisFrame = 0;
-        while (cyclesThisFrame < 29780) { // Authentic NTSC cycles per frame
-            int cycles = systemGlobal->cpu->step();
-            systemGlobal->ppu.step(cycles, systemGlobal->cpu);
-            systemGlobal->apu.step(cycles);
-            
-            if (systemGlobal->ppu.nmiOccurred) {
-                systemGlobal->cpu->triggerNMI();
-                systemGlobal->ppu.nmiOccurred = false;
-            } else if (systemGlobal->cpu->irqPending) {
-                systemGlobal->cpu->triggerIRQ();
+        // The CPU runs straight to the next scheduled event; the owning device then
+        // catches up, raises its interrupt line and posts its next event.
+        NesoSystem& sys = *systemGlobal;
+        Scheduler& events = sys.scheduler;
+        sys.cpu->skippedCycles = 0;
+        for (;;) {
+            sys.cpu->runUntil(events.next);
+            uint64_t now = sys.cpu->totalCycles;
+            if (events.due(Event::VBlank, now)) sys.ppu.catchUp(now);
+            if (events.due(Event::FrameIrq, now)) sys.apu.catchUp(now);
+            if (events.due(Event::FrameEnd, now)) {
+                sys.ppu.catchUp(now);
+                sys.apu.catchUp(now);
+                sys.apu.endFrame();
+                events.schedule(Event::FrameEnd, events.at[(int)Event::FrameEnd] + CYCLES_PER_FRAME);
+                break;
             }
-            cyclesThisFrame += cycles;
         }
+        if (sys.deferred) sys.deferred->submit(sys.ppu.syncedCycle);
 
         // --- Production Telemetry (Phase 20) ---
         systemGlobal->frameCounter++;
+        systemGlobal->idleCyclesLastFrame = systemGlobal->cpu->skippedCycles;
 
         if (systemGlobal->cpu->pc == systemGlobal->lastPC) {
             systemGlobal->stagnantFrames++;
@@ -133,9 +180,14 @@ Java_com_neso_core_MainActivity_loadRom(JNIEnv* env, jobject thiz, jbyteArray da
         }
 
         if (systemGlobal->frameCounter % 300 == 0) {
-            LOGD("💓 Heartbeat: PC=%04X Sl=%d Cyc=%d Stagnant=%d Audit=%08X", 
+            LOGD("💓 Heartbeat: PC=%04X Sl=%d Cyc=%d Stagnant=%d Idle=%u Elided=%u Audit=%08X", 
                  systemGlobal->cpu->pc, systemGlobal->ppu.scanline, systemGlobal->ppu.cycle, 
-                 systemGlobal->stagnantFrames, systemGlobal->cpu->getChecksum());
+                 systemGlobal->stagnantFrames, systemGlobal->idleCyclesLastFrame,
+                 systemGlobal->ppu.framesElided, systemGlobal->cpu->getChecksum());
+            if (systemGlobal->deferred) {
+                LOGD("Deferred rendering: %u frames submitted, %u overruns",
+                     systemGlobal->deferred->framesSubmitted, systemGlobal->deferred->overruns);
+            }
             
             if (systemGlobal->stagnantFrames > 300) { 
                 LOGW("⚠️ WARNING: CPU might be stuck! PC=0x%04X", systemGlobal->cpu->pc);
@@ -145,19 +197,89 @@ Java_com_neso_core_MainActivity_loadRom(JNIEnv* env, jobject thiz, jbyteArray da
 JNIEXPORT void JNICALL
 Java_com_neso_core_MainActivity_renderFrame(JNIEnv* env, jobject thiz, jintArray output) {
     if (!output || !systemGlobal) return;
-    env->SetIntArrayRegion(output, 0, SCREEN_WIDTH * SCREEN_HEIGHT, (const jint*)systemGlobal->screenBuffer);
+    // In the active pixel format: RGB565 packs two pixels per int
+    int bytes = SCREEN_WIDTH * SCREEN_HEIGHT * systemGlobal->palette.bytesPerPixel();
+    if (env->GetArrayLength(output) * 4 < bytes) return;
+    // The latest complete frame; stepCpu may be drawing the next one on another thread.
+    // Color conversion happens here, on the caller's thread, straight into the Java array
+    const IndexedFrame& frame = systemGlobal->screen.acquire();
+    void* pixels = env->GetPrimitiveArrayCritical(output, nullptr);
+    if (!pixels) return;
+    convertFrame(frame, systemGlobal->palette, pixels);
+    env->ReleasePrimitiveArrayCritical(output, pixels, 0);
+    systemGlobal->presentedFrame = frame.sequence;
+    systemGlobal->presentedPalette = systemGlobal->palette.version;
 }
 
 JNIEXPORT jint JNICALL
-Java_com_neso_core_MainActivity_getAudioSamples(JNIEnv* env, jobject thiz, jbyteArray out) {
+Java_com_neso_core_MainActivity_renderDirtyRows(JNIEnv* env, jobject thiz, jintArray output, jlongArray dirtyMask) {
+    // Like renderFrame, but `output` must still hold the last frame rendered into it by
+    // either call: only rows that changed since are converted. Their bits (row y in
+    // dirtyMask[y / 64], bit y % 64) go to dirtyMask when it has room for 4 longs.
+    // Returns the number of rows written.
+    if (!output || !systemGlobal) return 0;
+    NesoSystem& sys = *systemGlobal;
+    int bytes = SCREEN_WIDTH * SCREEN_HEIGHT * sys.palette.bytesPerPixel();
+    if (env->GetArrayLength(output) * 4 < bytes) return 0;
+
+    const IndexedFrame& frame = sys.screen.acquire();
+    bool repaint = sys.palette.version != sys.presentedPalette;
+    uint64_t mask[4] = {};
+    int rows = 0;
+    if (repaint || frame.sequence != sys.presentedFrame) {
+        void* pixels = env->GetPrimitiveArrayCritical(output, nullptr);
+        if (!pixels) return 0;
+        if (repaint) {
+            convertFrame(frame, sys.palette, pixels);
+            memset(mask, 0xFF, sizeof(mask));
+            rows = SCREEN_HEIGHT;
+        } else {
+            rows = convertDirtyRows(frame, sys.palette, pixels);
+            memcpy(mask, frame.dirtyRows, sizeof(mask));
+        }
+        env->ReleasePrimitiveArrayCritical(output, pixels, 0);
+        sys.presentedFrame = frame.sequence;
+        sys.presentedPalette = sys.palette.version;
+    }
+    if (dirtyMask && env->GetArrayLength(dirtyMask) >= 4) {
+        env->SetLongArrayRegion(dirtyMask, 0, 4, (const jlong*)mask);
+    }
+    return (jint)rows;
+}
+
+JNIEXPORT void JNICALL
+Java_com_neso_core_MainActivity_setPixelFormat(JNIEnv* env, jobject thiz, jint format) {
+    // PixelFormat order: 0 ARGB8888, 1 ABGR8888, 2 RGB565, 3 XRGB8888
+    if (!systemGlobal || format < 0 || format >= (jint)PixelFormat::Count) return;
+    systemGlobal->palette.setFormat((PixelFormat)format);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_neso_core_MainActivity_loadPalette(JNIEnv* env, jobject thiz, jbyteArray data) {
+    // Contents of a .pal file (64 or 512 RGB triplets); null restores the built-in palette
+    if (!systemGlobal) return JNI_FALSE;
+    if (!data) {
+        systemGlobal->palette.generate();
+        return JNI_TRUE;
+    }
+    jsize len = env->GetArrayLength(data);
+    jbyte* buf = env->GetByteArrayElements(data, 0);
+    bool loaded = systemGlobal->palette.load((const uint8_t*)buf, (size_t)len);
+    env->ReleaseByteArrayElements(data, buf, JNI_ABORT);
+    if (!loaded) LOGW("Palette rejected: %d bytes (expected 192 or 1536)", (int)len);
+    return loaded ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jint JNICALL
+Java_com_neso_core_MainActivity_getAudioSamples(JNIEnv* env, jobject thiz, jshortArray out) {
     if (!systemGlobal) return 0;
     jsize len = env->GetArrayLength(out);
-    static uint8_t temp[AudioRingBuffer::SIZE];
+    static int16_t temp[AudioRingBuffer::SIZE];
     if (len > AudioRingBuffer::SIZE) len = AudioRingBuffer::SIZE;
     
     int read = systemGlobal->apu.ringBuffer.read(temp, (int)len);
     if (read > 0) {
-        env->SetByteArrayRegion(out, 0, read, (const jbyte*)temp);
+        env->SetShortArrayRegion(out, 0, read, (const jshort*)temp);
     }
     
     // Instrumentation
@@ -176,12 +298,97 @@ Java_com_neso_core_MainActivity_getAudioSamples(JNIEnv* env, jobject thiz, jbyte
     return (jint)read;
 }
 
+JNIEXPORT void JNICALL
+Java_com_neso_core_MainActivity_setAudioOutputRate(JNIEnv* env, jobject thiz, jint rate) {
+    // The AudioTrack's rate, normally the device's native one
+    if (!systemGlobal) return;
+    if (rate < 8000 || rate > 192000) {
+        LOGW("Audio output rate %d Hz rejected", (int)rate);
+        return;
+    }
+    systemGlobal->apu.setOutputRate(rate);
+}
+
 JNIEXPORT jint JNICALL
 Java_com_neso_core_MainActivity_getAudioBufferLevel(JNIEnv* env, jobject thiz) {
     if (!systemGlobal) return 0;
     return systemGlobal->apu.ringBuffer.getLevelPct();
 }
 
+JNIEXPORT void JNICALL
+Java_com_neso_core_MainActivity_runBenchmarks(JNIEnv* env, jobject thiz) {
+    // The benchmarks take several seconds, so they run on their own thread and this returns at once.
+    // Results go to logcat (tag NesoBench); each benchmark uses its own scratch system.
+    // Calls made while a run is still in progress are ignored.
+#ifdef NESO_BENCHMARKS
+    static std::atomic<bool> running{false};
+    if (running.exchange(true)) {
+        LOGW("Benchmarks already running");
+        return;
+    }
+    std::thread([] {
+        runCpuBenchmark(20000000);
+        runCompositorBenchmark(200000);
+        runAudioFilterBenchmark(20000);
+        runResamplerBenchmark(10000000);
+        running.store(false);
+    }).detach();
+#else
+    LOGW("Benchmarks not built (NESO_BENCHMARKS is off)");
+#endif
+}
+
+JNIEXPORT void JNICALL
+Java_com_neso_core_MainActivity_setCachedInterpreter(JNIEnv* env, jobject thiz, jboolean enabled) {
+    if (systemGlobal && systemGlobal->cpu) systemGlobal->cpu->setBlockCache(enabled);
+}
+
+JNIEXPORT void JNICALL
+Java_com_neso_core_MainActivity_setDynarec(JNIEnv* env, jobject thiz, jboolean enabled, jboolean lockstep) {
+    if (systemGlobal && systemGlobal->cpu) systemGlobal->cpu->setDynarec(enabled, lockstep);
+}
+
+JNIEXPORT void JNICALL
+Java_com_neso_core_MainActivity_setIdleSkip(JNIEnv* env, jobject thiz, jboolean enabled) {
+    if (systemGlobal && systemGlobal->cpu) systemGlobal->cpu->setIdleSkip(enabled);
+}
+
+JNIEXPORT void JNICALL
+Java_com_neso_core_MainActivity_setFrameElision(JNIEnv* env, jobject thiz, jboolean enabled) {
+    if (!systemGlobal) return;
+    systemGlobal->ppu.frameElision = enabled;
+    if (systemGlobal->deferred) {
+        systemGlobal->deferred->configure(enabled, systemGlobal->ppu.nametables != nullptr);
+    }
+}
+
+JNIEXPORT void JNICALL
+Java_com_neso_core_MainActivity_setNametableCache(JNIEnv* env, jobject thiz, jboolean enabled) {
+    if (!systemGlobal) return;
+    systemGlobal->ppu.setNametableCache(enabled);
+    if (systemGlobal->deferred) systemGlobal->deferred->configure(systemGlobal->ppu.frameElision, enabled);
+}
+
+JNIEXPORT void JNICALL
+Java_com_neso_core_MainActivity_setDeferredRendering(JNIEnv* env, jobject thiz, jboolean enabled) {
+    // Between frames: the PPU of the emulation thread hands its output to a worker
+    // thread's, or takes it back once the worker has finished everything handed over
+    if (!systemGlobal || !systemGlobal->mapper) return;
+    NesoSystem& sys = *systemGlobal;
+    if (enabled && !sys.deferred) {
+        sys.deferred.reset(new DeferredRenderer(sys.ppu, *sys.mapper, *sys.rom));
+    } else if (!enabled) {
+        sys.deferred.reset();
+    }
+}
+
+JNIEXPORT jint JNICALL
+Java_com_neso_core_MainActivity_getIdleCycles(JNIEnv* env, jobject thiz) {
+    // CPU cycles of the last frame spent fast-forwarding through polling loops
+    if (!systemGlobal) return 0;
+    return (jint)systemGlobal->idleCyclesLastFrame;
+}
+
 JNIEXPORT void JNICALL
 Java_com_neso_core_MainActivity_setButtonState(JNIEnv* env, jobject thiz, jint button, jboolean pressed) {
     if (systemGlobal && systemGlobal->cpu) {
@@ -0,0 +1,84 @@
+/*
+ * Kernel Dispatch Module
+ * Responsibility: Choose between the scalar and SIMD versions of a hot loop.
+ * A module lists its kernels once, best first and the scalar one (always built) last.
+ * An entry's function is null where the build lacks the instruction set; `usable`
+ * asks the running CPU where the build alone can't tell. KernelTable answers
+ * get / supported / best / name from that list.
+ */
+
+#ifndef KERNEL_DISPATCH_H
+#define KERNEL_DISPATCH_H
+
+#include <cstddef>
+
+// Entry functions for instruction sets the build may lack
+#if defined(__SSE2__)
+#define SSE2_KERNEL(fn) fn
+#else
+#define SSE2_KERNEL(fn) nullptr
+#endif
+#if defined(__x86_64__)
+#define AVX2_KERNEL(fn) fn // Built with a target attribute, pair with cpuHasAvx2
+#else
+#define AVX2_KERNEL(fn) nullptr
+#endif
+#if defined(__aarch64__)
+#define NEON_KERNEL(fn) fn
+#else
+#define NEON_KERNEL(fn) nullptr
+#endif
+
+inline bool cpuHasAvx2() {
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+template <typename Kind, typename Fn>
+struct KernelEntry {
+    Kind kind;
+    const char* name;
+    Fn fn;                      // Null where the build lacks the instruction set
+    bool (*usable)() = nullptr; // Runtime CPU check; null when the build is enough
+};
+
+template <typename Kind, typename Fn>
+class KernelTable {
+public:
+    template <size_t N>
+    constexpr KernelTable(const KernelEntry<Kind, Fn> (&list)[N]) : entries(list), count(N) {}
+
+    Fn get(Kind kind) const { // Null where unsupported
+        const KernelEntry<Kind, Fn>* e = find(kind);
+        return e && e->fn && (!e->usable || e->usable()) ? e->fn : nullptr;
+    }
+    bool supported(Kind kind) const { return get(kind) != nullptr; }
+    Kind best() const {
+        for (size_t i = 0; i + 1 < count; i++) {
+            if (supported(entries[i].kind)) return entries[i].kind;
+        }
+        return entries[count - 1].kind;
+    }
+    Fn bestFn() const { return get(best()); }
+    const char* name(Kind kind) const {
+        const KernelEntry<Kind, Fn>* e = find(kind);
+        return e ? e->name : "?";
+    }
+
+private:
+    const KernelEntry<Kind, Fn>* entries;
+    size_t count;
+
+    const KernelEntry<Kind, Fn>* find(Kind kind) const {
+        for (size_t i = 0; i < count; i++) {
+            if (entries[i].kind == kind) return &entries[i];
+        }
+        return nullptr;
+    }
+};
+
+#endif
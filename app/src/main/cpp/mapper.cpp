@@ -1,13 +1,72 @@
 #include "mapper.h"
 #include "rom.h"
+#include "ppu.h"
+#include "deferred_ppu.h"
+#include <cstring>
 #include <android/log.h>
 
+void Mapper::attachPpu(PPU* target) {
+    ppu = target;
+    if (ppu) ppu->chr = &chrCache;
+    mapPpuPages();
+}
+
+void Mapper::mapPpuPages() {
+    mapChr(0x0000, 0x2000, 0);
+    mapNametables(headerMirroring());
+}
+
+void Mapper::mapChr(uint16_t start, uint32_t size, uint32_t chrOffset) {
+    chrCache.map(start, size, chrOffset);
+    PpuMapping before = ppuMapping;
+    for (uint32_t off = 0; off < size; off += PpuPageTable::PAGE_SIZE) {
+        uint32_t src = chrOffset + off;
+        bool inRange = src + PpuPageTable::PAGE_SIZE <= rom->chrROM.size();
+        int page = (start + off) >> PpuPageTable::PAGE_SHIFT;
+        ppuMapping.chr[page] = inRange ? (int32_t)src : -1;
+        if (ppu) ppu->pages.chr[page] = inRange ? &rom->chrROM[src] : PpuPageTable::blank();
+    }
+    if (memcmp(&before, &ppuMapping, sizeof(before)) != 0) remapped();
+}
+
+void Mapper::mapNametables(MirrorMode mode) {
+    PpuMapping before = ppuMapping;
+    for (int n = 0; n < PpuPageTable::NAMETABLES; n++) {
+        ppuMapping.nametable[n] = getMirrorAddr(0x2000 + n * PpuPageTable::PAGE_SIZE, mode);
+        if (ppu) ppu->pages.nametable[n] = &ppuVram[ppuMapping.nametable[n]];
+    }
+    if (memcmp(&before, &ppuMapping, sizeof(before)) != 0) remapped();
+}
+
+// A deferred renderer's PPU follows the change at the same cycle (deferred_ppu.h)
+void Mapper::remapped() {
+    if (ppu && ppu->writeLog) ppu->writeLog->map(ppu->syncedCycle, ppuMapping);
+}
+
+void Mapper::syncPpu(uint64_t cycles) {
+    if (!ppu) return;
+    ppu->catchUp(cycles);
+    ppu->bumpGeneration();
+    if (ppu->nametables) ppu->nametables->invalidateAll();
+}
+
 Mapper0::Mapper0(Rom* rom) : Mapper(rom) {
     reset();
 }
 
 void Mapper0::reset() {}
 
+void Mapper0::mapCpuPages() {
+    if (!cpuPages) return;
+    mapPrgRam();
+    if (rom->getPrgSize() > 16384) {
+        mapPrgRom(0x8000, 0x8000, 0);
+    } else { // NROM-128: mirror the single bank
+        mapPrgRom(0x8000, 0x4000, 0);
+        mapPrgRom(0xC000, 0x4000, 0);
+    }
+}
+
 uint8_t Mapper0::cpuRead(uint16_t addr) {
     if (addr >= 0x8000) {
         uint16_t mask = (rom->getPrgSize() > 16384) ? 0x7FFF : 0x3FFF;
@@ -29,6 +88,7 @@ uint8_t Mapper0::ppuRead(uint16_t addr) {
 void Mapper0::ppuWrite(uint16_t addr, uint8_t val) {
     if (addr < 0x2000 && rom->getChrSize() == 8192) {
         if (addr < rom->chrROM.size()) rom->chrROM[addr] = val;
+        chrCache.invalidate(addr);
     }
     else if (addr >= 0x2000 && addr <= 0x3EFF) {
         MirrorMode mode = rom->isVerticalMirroring() ? MirrorMode::Vertical : MirrorMode::Horizontal;
@@ -45,6 +105,15 @@ Mapper2::Mapper2(Rom* rom) : Mapper(rom) {
 
 void Mapper2::reset() {
     prgBankSelect = 0;
+    mapCpuPages();
+}
+
+void Mapper2::mapCpuPages() {
+    if (!cpuPages) return;
+    mapPrgRam();
+    uint8_t bank = prgBankSelect & prgBankMask;
+    mapPrgRom(0x8000, 0x4000, (uint32_t)bank * 16384);
+    mapPrgRom(0xC000, 0x4000, (uint32_t)(numPrgBanks - 1) * 16384);
 }
 
 uint8_t Mapper2::cpuRead(uint16_t addr) {
@@ -62,7 +131,9 @@ uint8_t Mapper2::cpuRead(uint16_t addr) {
 
 void Mapper2::cpuWrite(uint16_t addr, uint8_t val, uint64_t cycles) {
     if (addr >= 0x8000) {
+        bool changed = (val & prgBankMask) != (prgBankSelect & prgBankMask);
         prgBankSelect = val; 
+        if (changed) mapCpuPages();
     } else {
         Mapper::cpuWrite(addr, val, cycles);
     }
@@ -78,6 +149,7 @@ uint8_t Mapper2::ppuRead(uint16_t addr) {
 void Mapper2::ppuWrite(uint16_t addr, uint8_t val) {
     if (addr < 0x2000) {
         rom->chrROM[addr] = val;
+        chrCache.invalidate(addr);
     } else if (addr >= 0x2000 && addr <= 0x3EFF) {
         MirrorMode mode = rom->isVerticalMirroring() ? MirrorMode::Vertical : MirrorMode::Horizontal;
         ppuVram[getMirrorAddr(addr, mode) % 2048] = val;
@@ -101,11 +173,31 @@ Mapper3::Mapper3(Rom* rom) : Mapper(rom) {
 
 void Mapper3::reset() {
     chrBankSelect = 0;
+    mapPpuPages();
+}
+
+void Mapper3::mapPpuPages() {
+    mapChr(0x0000, 0x2000, (uint32_t)(chrBankSelect & chrBankMask) * 8192);
+    mapNametables(headerMirroring());
+}
+
+void Mapper3::mapCpuPages() {
+    if (!cpuPages) return;
+    // No PRG-RAM on CNROM: $6000-$7FFF stays on the slow path (reads as 0).
+    if (rom->getPrgSize() > 16384) {
+        mapPrgRom(0x8000, 0x8000, 0);
+    } else {
+        mapPrgRom(0x8000, 0x4000, 0);
+        mapPrgRom(0xC000, 0x4000, 0);
+    }
 }
 
 void Mapper3::cpuWrite(uint16_t addr, uint8_t val, uint64_t cycles) {
-    if (addr >= 0x8000) chrBankSelect = val;
-    else Mapper::cpuWrite(addr, val, cycles);
+    if (addr >= 0x8000) {
+        if ((val & chrBankMask) != (chrBankSelect & chrBankMask)) syncPpu(cycles);
+        chrBankSelect = val;
+        mapPpuPages();
+    } else Mapper::cpuWrite(addr, val, cycles);
 }
 
 uint8_t Mapper3::ppuRead(uint16_t addr) {
@@ -155,24 +247,49 @@ void Mapper1::updateOffsets() {
             chrOffsets[1] = ((chrBank0 | 0x01) % numChrBanks) * 4096;
         }
     }
+    mapPpuPages();
+
+    // PRG Banks: most writes (CHR banks, mirroring) leave them where they are
+    uint32_t previous[2] = {prgOffsets[0], prgOffsets[1]};
+    if (numPrgBanks > 0) {
+        uint8_t mode = (control >> 2) & 0x03;
+        switch (mode) {
+            case 0: case 1: // 32KB mode
+                prgOffsets[0] = ((prgBank & 0xFE) % numPrgBanks) * 16384;
+                prgOffsets[1] = ((prgBank | 0x01) % numPrgBanks) * 16384;
+                break;
+            case 2: // Fix first, switch last
+                prgOffsets[0] = 0;
+                prgOffsets[1] = (prgBank % numPrgBanks) * 16384;
+                break;
+            case 3: // Switch first, fix last
+                prgOffsets[0] = (prgBank % numPrgBanks) * 16384;
+                prgOffsets[1] = (numPrgBanks - 1) * 16384;
+                break;
+        }
+    }
+    if (prgOffsets[0] != previous[0] || prgOffsets[1] != previous[1]) mapCpuPages();
+}
 
-    // PRG Banks
-    if (numPrgBanks == 0) return;
-    uint8_t mode = (control >> 2) & 0x03;
-    switch (mode) {
-        case 0: case 1: // 32KB mode
-            prgOffsets[0] = ((prgBank & 0xFE) % numPrgBanks) * 16384;
-            prgOffsets[1] = ((prgBank | 0x01) % numPrgBanks) * 16384;
-            break;
-        case 2: // Fix first, switch last
-            prgOffsets[0] = 0;
-            prgOffsets[1] = (prgBank % numPrgBanks) * 16384;
-            break;
-        case 3: // Switch first, fix last
-            prgOffsets[0] = (prgBank % numPrgBanks) * 16384;
-            prgOffsets[1] = (numPrgBanks - 1) * 16384;
-            break;
+// 8KB of CHR-RAM (no CHR banks) stays mapped straight through
+void Mapper1::mapPpuPages() {
+    if (numChrBanks > 0) {
+        mapChr(0x0000, 0x1000, chrOffsets[0]);
+        mapChr(0x1000, 0x1000, chrOffsets[1]);
+    } else {
+        mapChr(0x0000, 0x2000, 0);
     }
+    static const MirrorMode modes[4] = {
+        MirrorMode::SingleScreenLower, MirrorMode::SingleScreenUpper, MirrorMode::Vertical, MirrorMode::Horizontal
+    };
+    mapNametables(modes[control & 0x03]);
+}
+
+void Mapper1::mapCpuPages() {
+    if (!cpuPages) return;
+    mapPrgRam();
+    mapPrgRom(0x8000, 0x4000, prgOffsets[0]);
+    mapPrgRom(0xC000, 0x4000, prgOffsets[1]);
 }
 
 uint8_t Mapper1::cpuRead(uint16_t addr) {
@@ -206,6 +323,9 @@ void Mapper1::cpuWrite(uint16_t addr, uint8_t val, uint64_t cycles) {
 
         if (complete) {
             uint8_t data = shiftReg;
+            // Control (mirroring, CHR mode) or a CHR bank
+            if ((addr <= 0x9FFF && data != control) || (addr >= 0xA000 && addr <= 0xBFFF && data != chrBank0) ||
+                (addr >= 0xC000 && addr <= 0xDFFF && data != chrBank1)) syncPpu(cycles);
             // Write to internal registers based on address
             if (addr <= 0x9FFF) {
                 control = data;
@@ -247,7 +367,10 @@ uint8_t Mapper1::ppuRead(uint16_t addr) {
 
 void Mapper1::ppuWrite(uint16_t addr, uint8_t val) {
     if (addr < 0x2000) {
-        if (rom->getChrSize() == 0) rom->chrROM[addr] = val; // CHR-RAM
+        if (rom->getChrSize() == 0) { // CHR-RAM
+            rom->chrROM[addr] = val;
+            chrCache.invalidate(addr);
+        }
     } else if (addr >= 0x2000 && addr <= 0x3EFF) {
         uint8_t m = control & 0x03;
         MirrorMode mode;
@@ -272,6 +395,20 @@ Mapper7::Mapper7(Rom* rom) : Mapper(rom) {
 void Mapper7::reset() {
     prgBank = 0;
     mirroring = 0;
+    mapCpuPages();
+    mapPpuPages();
+}
+
+void Mapper7::mapPpuPages() {
+    mapChr(0x0000, 0x2000, 0);
+    mapNametables(mirroring ? MirrorMode::SingleScreenUpper : MirrorMode::SingleScreenLower);
+}
+
+void Mapper7::mapCpuPages() {
+    if (!cpuPages) return;
+    mapPrgRam();
+    int bank = prgBank & prgBankMask;
+    mapPrgRom(0x8000, 0x8000, (uint32_t)bank * 32768);
 }
 
 uint8_t Mapper7::cpuRead(uint16_t addr) {
@@ -284,9 +421,16 @@ uint8_t Mapper7::cpuRead(uint16_t addr) {
 
 void Mapper7::cpuWrite(uint16_t addr, uint8_t val, uint64_t cycles) {
     if (addr >= 0x8000) {
-        prgBank = val & 0x07; // Usually 3 bits are enough for 256KB games
+        uint8_t bank = val & 0x07; // Usually 3 bits are enough for 256KB games
+        bool changed = (bank & prgBankMask) != (prgBank & prgBankMask);
+        prgBank = bank;
+        if (changed) mapCpuPages();
         // Bit 4 selects nametable for Single-Screen mirroring
-        mirroring = (val >> 4) & 1;
+        if (((val >> 4) & 1) != mirroring) {
+            syncPpu(cycles);
+            mirroring = (val >> 4) & 1;
+            mapPpuPages();
+        }
     } else {
         Mapper::cpuWrite(addr, val, cycles);
     }
@@ -301,6 +445,7 @@ uint8_t Mapper7::ppuRead(uint16_t addr) {
 void Mapper7::ppuWrite(uint16_t addr, uint8_t val) {
     if (addr < 0x2000) {
         if (addr < rom->chrROM.size()) rom->chrROM[addr] = val;
+        chrCache.invalidate(addr);
     }
     else if (addr >= 0x2000 && addr <= 0x3EFF) {
         MirrorMode mode = mirroring ? MirrorMode::SingleScreenUpper : MirrorMode::SingleScreenLower;
@@ -9,6 +9,10 @@
 
 #include <cstdint>
 #include "rom.h"
+#include "memory_map.h"
+#include "chr_cache.h"
+
+struct PPU;
 
 enum class MirrorMode {
     Horizontal,
@@ -19,7 +23,7 @@ enum class MirrorMode {
 
 class Mapper {
 public:
-    Mapper(Rom* rom) : rom(rom) {}
+    Mapper(Rom* rom) : rom(rom) { chrCache.attach(&rom->chrROM); }
     virtual ~Mapper() {}
 
     virtual uint8_t cpuRead(uint16_t addr) {
@@ -33,6 +37,27 @@ public:
     virtual void ppuWrite(uint16_t addr, uint8_t val) = 0;
     virtual void reset() {}
 
+    // CPU page table: the mapper owns the $6000-$FFFF entries and refreshes them
+    // whenever banking changes, so PRG fetches never reach cpuRead().
+    void attachCpuPages(CpuPageTable* pages) {
+        cpuPages = pages;
+        mapCpuPages();
+    }
+    virtual void mapCpuPages() {
+        if (!cpuPages) return;
+        mapPrgRam();
+    }
+
+    // The PPU runs behind the CPU; it is caught up before CHR banks or mirroring change
+    // so everything up to the write renders with the old mapping. It fetches patterns
+    // from chrCache and reads everything else through its PpuPageTable; mapPpuPages()
+    // points both at the current CHR banks and mirroring after every such change.
+    void attachPpu(PPU* target);
+    virtual void mapPpuPages(); // Default: 8KB of CHR at 0, header mirroring
+    ChrTileCache chrCache;
+    PpuMapping ppuMapping = {};  // What mapPpuPages() last set up
+    const uint8_t* nametableRam() const { return ppuVram; }
+
     uint16_t getMirrorAddr(uint16_t addr, MirrorMode mode) {
         uint16_t ntAddr = addr & 0x0FFF;
         switch (mode) {
@@ -53,6 +78,34 @@ protected:
     Rom* rom;
     uint8_t ppuVram[2048] = {0}; // 2KB internal Nametable memory
     uint8_t prgRam[8192] = {0};  // 8KB Work/PRG RAM ($6000-$7FFF)
+    CpuPageTable* cpuPages = nullptr;
+    PPU* ppu = nullptr;
+
+    void syncPpu(uint64_t cycles); // Before any CHR/nametable mapping change (catches up, bumps the generation, drops the nametable cache)
+
+    // Points [start, start + size) of the pattern space at CHR offset `chrOffset`
+    // (chrCache and the PPU's pages alike); windows past the end of CHR read as zeros.
+    void mapChr(uint16_t start, uint32_t size, uint32_t chrOffset);
+    void mapNametables(MirrorMode mode);
+    void remapped();
+    MirrorMode headerMirroring() const {
+        return rom->isVerticalMirroring() ? MirrorMode::Vertical : MirrorMode::Horizontal;
+    }
+
+    void mapPrgRam() {
+        cpuPages->map(0x6000, 0x2000, prgRam, true);
+        // $6000 is the test-ROM status byte watched in CPU::write: keep that page's writes on the slow path.
+        cpuPages->setFlags(CpuPageTable::page(0x6000), CpuPageTable::TRAP_WRITES, true);
+    }
+    // Maps `size` bytes of PRG-ROM starting at `romOffset`. Pages past the end of the
+    // image stay unmapped so cpuRead() keeps its safePrgRead() semantics.
+    void mapPrgRom(uint16_t start, uint32_t size, uint32_t romOffset) {
+        for (uint32_t off = 0; off < size; off += CpuPageTable::PAGE_SIZE) {
+            uint32_t src = romOffset + off;
+            bool inRange = src < rom->prgROM.size() && rom->prgROM.size() - src >= CpuPageTable::PAGE_SIZE;
+            cpuPages->map(start + off, CpuPageTable::PAGE_SIZE, inRange ? &rom->prgROM[src] : nullptr, false);
+        }
+    }
 };
 
 class Mapper0 : public Mapper {
@@ -63,6 +116,7 @@ public:
     uint8_t ppuRead(uint16_t addr) override;
     void ppuWrite(uint16_t addr, uint8_t val) override;
     void reset() override;
+    void mapCpuPages() override;
 };
 
 class Mapper2 : public Mapper { // UxROM
@@ -73,6 +127,7 @@ public:
     uint8_t ppuRead(uint16_t addr) override;
     void ppuWrite(uint16_t addr, uint8_t val) override;
     void reset() override;
+    void mapCpuPages() override;
 private:
     uint16_t prgBankSelect = 0;
     int numPrgBanks = 0;
@@ -87,6 +142,8 @@ public:
     uint8_t ppuRead(uint16_t addr) override;
     void ppuWrite(uint16_t addr, uint8_t val) override;
     void reset() override;
+    void mapCpuPages() override;
+    void mapPpuPages() override;
 private:
     uint8_t chrBankSelect = 0;
     int numChrBanks = 0;
@@ -102,6 +159,8 @@ public:
     void ppuWrite(uint16_t addr, uint8_t val) override;
 public:
     void reset() override;
+    void mapCpuPages() override;
+    void mapPpuPages() override;
     void updateOffsets();
     uint8_t shiftReg = 0x10;
     uint8_t control = 0x0C;
@@ -123,6 +182,8 @@ public:
     uint8_t ppuRead(uint16_t addr) override;
     void ppuWrite(uint16_t addr, uint8_t val) override;
     void reset() override;
+    void mapCpuPages() override;
+    void mapPpuPages() override;
 private:
     uint8_t prgBank = 0;
     uint8_t mirroring = 0; // 0=screenA, 1=screenB
@@ -0,0 +1,115 @@
+/*
+ * CPU Memory Map Module
+ * Responsibility: Page table for the 64KB CPU bus.
+ * Each 2KB page either points straight at backing memory (RAM, PRG-ROM, PRG-RAM)
+ * or falls through to an I/O handler slot (PPU/APU registers, mapper registers).
+ * The PPU's pattern and nametable space has a smaller table of its own (PpuPageTable).
+ */
+
+#ifndef MEMORY_MAP_H
+#define MEMORY_MAP_H
+
+#include <cstdint>
+
+struct CPU;
+
+struct CpuPageTable {
+    // 2KB matches the internal RAM mirror size, so $0000-$1FFF is four direct pages.
+    static constexpr int PAGE_SHIFT = 11;
+    static constexpr int PAGE_SIZE = 1 << PAGE_SHIFT;
+    static constexpr uint16_t PAGE_MASK = PAGE_SIZE - 1;
+    static constexpr int PAGE_COUNT = 0x10000 >> PAGE_SHIFT;
+
+    typedef uint8_t (*IoRead)(CPU& cpu, uint16_t addr);
+    typedef void (*IoWrite)(CPU& cpu, uint16_t addr, uint8_t val);
+
+    // Direct pointers: null means "not plain memory", take the I/O slot instead.
+    const uint8_t* read[PAGE_COUNT] = {nullptr};
+    uint8_t* write[PAGE_COUNT] = {nullptr};
+
+    // Slow path, installed by CPU::reset() for every page.
+    IoRead ioRead[PAGE_COUNT] = {nullptr};
+    IoWrite ioWrite[PAGE_COUNT] = {nullptr};
+
+    // Writable memory behind each page, kept even while `flags` force writes off the fast path.
+    uint8_t* writable[PAGE_COUNT] = {nullptr};
+    enum : uint8_t {
+        TRAP_WRITES = 1 << 0, // Writes always go through ioWrite (mapper-side hooks)
+        WATCH_CODE  = 1 << 1  // Page holds cached code: CPU::write invalidates the block cache
+    };
+    uint8_t flags[PAGE_COUNT] = {0};
+    uint32_t generation = 0; // Bumped on every remap, lets decoded code notice bank switches
+
+    static int page(uint16_t addr) { return addr >> PAGE_SHIFT; }
+
+    // Maps [start, start + size) onto `base`. A null `base` (or read-only memory with
+    // isWritable = false) sends those accesses back to the I/O slots.
+    void map(uint16_t start, uint32_t size, uint8_t* base, bool isWritable) {
+        for (uint32_t off = 0; off < size; off += PAGE_SIZE) {
+            int p = page(start + off);
+            read[p] = base ? base + off : nullptr;
+            writable[p] = (base && isWritable) ? base + off : nullptr;
+            refresh(p);
+        }
+        generation++;
+    }
+
+    void setFlags(int p, uint8_t mask, bool on) {
+        flags[p] = on ? (flags[p] | mask) : (flags[p] & ~mask);
+        refresh(p);
+    }
+
+    void refresh(int p) { write[p] = flags[p] ? nullptr : writable[p]; }
+
+    // Cached code lives in `page`: watch it and every mirror of the same memory.
+    void watchCode(int p) {
+        for (int q = 0; q < PAGE_COUNT; q++) {
+            if (read[q] == read[p] && !(flags[q] & WATCH_CODE)) setFlags(q, WATCH_CODE, true);
+        }
+    }
+    void unwatchCode() {
+        for (int q = 0; q < PAGE_COUNT; q++) {
+            if (flags[q] & WATCH_CODE) setFlags(q, WATCH_CODE, false);
+        }
+    }
+};
+
+// PPU reads of $0000-$3EFF: eight 1KB pattern pages and the four logical nametables,
+// pointed at CHR memory and nametable RAM by the mapper whenever its CHR banks or
+// mirroring change, so a read is a shift and an index. Writes still go through
+// Mapper::ppuWrite() (CHR-RAM and nametable writes are rare and need the caches told).
+struct PpuPageTable {
+    static constexpr int PAGE_SHIFT = 10;
+    static constexpr int PAGE_SIZE = 1 << PAGE_SHIFT;
+    static constexpr uint16_t PAGE_MASK = PAGE_SIZE - 1;
+    static constexpr int CHR_PAGES = 0x2000 >> PAGE_SHIFT;
+    static constexpr int NAMETABLES = 4;
+
+    const uint8_t* chr[CHR_PAGES];
+    const uint8_t* nametable[NAMETABLES];
+
+    // Reads as zeros: unmapped pages, and CHR windows past the end of CHR memory
+    static const uint8_t* blank() {
+        static const uint8_t zeros[PAGE_SIZE] = {0};
+        return zeros;
+    }
+
+    PpuPageTable() {
+        for (const uint8_t*& p : chr) p = blank();
+        for (const uint8_t*& p : nametable) p = blank();
+    }
+
+    uint8_t read(uint16_t addr) const { // $3000-$3EFF mirrors $2000-$2EFF
+        if (addr < 0x2000) return chr[addr >> PAGE_SHIFT][addr & PAGE_MASK];
+        return nametable[(addr >> PAGE_SHIFT) & (NAMETABLES - 1)][addr & PAGE_MASK];
+    }
+};
+
+// Where the PPU's pages point, as offsets: into CHR memory (-1: blank) and into the
+// 2KB of nametable RAM. Enough to rebuild the same mapping over a copy of both.
+struct PpuMapping {
+    int32_t chr[PpuPageTable::CHR_PAGES];
+    uint16_t nametable[PpuPageTable::NAMETABLES];
+};
+
+#endif
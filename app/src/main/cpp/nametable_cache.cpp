@@ -0,0 +1,61 @@
+#include "nametable_cache.h"
+#include <cstring>
+#include <algorithm>
+
+void NametableCache::invalidateAll() {
+    std::fill(&tiles[0][0], &tiles[0][0] + TABLES * ROWS * COLUMNS, NO_TILE);
+    memset(patternStale, 0, sizeof(patternStale));
+    patternsDirty = false;
+}
+
+void NametableCache::begin(uint16_t base) {
+    if (base != patternBase) {
+        invalidateAll();
+        patternBase = base;
+    }
+    if (patternsDirty) sweepPatterns();
+}
+
+// Pattern writes come in bursts (a whole tile or bank at a time), so the tiles using
+// them are looked for once, when the cache is next read.
+void NametableCache::sweepPatterns() {
+    for (int t = 0; t < TABLES; t++) {
+        for (uint16_t& tile : tiles[t]) {
+            if (tile != NO_TILE && patternStale[tile]) tile = NO_TILE;
+        }
+    }
+    memset(patternStale, 0, sizeof(patternStale));
+    patternsDirty = false;
+}
+
+void NametableCache::nametableWritten(uint16_t addr) {
+    int offset = addr & 0x03FF;
+    if (offset < ROWS * COLUMNS) {
+        for (int t = 0; t < TABLES; t++) tiles[t][offset] = NO_TILE;
+        return;
+    }
+    // Attribute byte: a 4x4 block of tiles (clipped at the bottom row)
+    int column = (offset & 0x07) * 4;
+    int row = ((offset >> 3) & 0x07) * 4;
+    for (int t = 0; t < TABLES; t++) {
+        for (int r = row; r < std::min(row + 4, ROWS); r++) {
+            for (int c = column; c < column + 4; c++) tiles[t][r * COLUMNS + c] = NO_TILE;
+        }
+    }
+}
+
+void NametableCache::draw(int table, int column, int row, uint8_t tileId, uint8_t palette, const uint16_t rows[8]) {
+    uint8_t* out = &pixels[table >> 1][row * 8][(table & 1) * WIDTH + column * 8];
+    for (int r = 0; r < 8; r++, out += PAIR_WIDTH) {
+        for (int i = 0; i < 8; i++) out[i] = (palette << 2) | ((rows[r] >> (14 - 2 * i)) & 3);
+    }
+    tiles[table][row * COLUMNS + column] = tileId;
+    tilesDrawn++;
+}
+
+void NametableCache::copy(int vertical, int y, int x, uint8_t* out, int count) const {
+    const uint8_t* line = pixels[vertical][y];
+    int first = std::min(count, PAIR_WIDTH - x);
+    memcpy(out, line + x, first);
+    memcpy(out + first, line, count - first);
+}
@@ -0,0 +1,65 @@
+/*
+ * Nametable Cache Module
+ * Responsibility: The four logical nametables kept pre-rendered as 256x240 bitmaps of
+ * background pixel values (attribute palette << 2 | pattern pixel, as the compositor
+ * takes them), so a line the PPU renders without mid-line changes is a scrolled copy.
+ * Tiles are drawn on first use and invalidated one by one on nametable, attribute
+ * and pattern writes; a new background pattern table or a mapping change (CHR bank,
+ * mirroring) invalidates everything.
+ */
+
+#ifndef NAMETABLE_CACHE_H
+#define NAMETABLE_CACHE_H
+
+#include <cstdint>
+
+struct NametableCache {
+    static constexpr int TABLES = 4;
+    static constexpr int COLUMNS = 32;
+    static constexpr int ROWS = 30;
+    static constexpr int WIDTH = COLUMNS * 8;
+    static constexpr int HEIGHT = ROWS * 8;
+    static constexpr int PAIR_WIDTH = 2 * WIDTH; // Horizontally adjacent tables side by side
+
+    NametableCache() { invalidateAll(); }
+
+    void invalidateAll();
+
+    // Before the lookups of a line: the background pattern table in use ($0000/$1000),
+    // and any pattern writes since the last line.
+    void begin(uint16_t patternBase);
+
+    // $2000-$3EFF at `addr` was written. Every table is hit at the same offset, which
+    // covers whatever the mirroring makes of it.
+    void nametableWritten(uint16_t addr);
+
+    // Pattern memory at `addr` was written. Tiles drawn from the same tile number in
+    // either pattern table go stale (a 4KB CHR bank may back both), at the next begin().
+    void patternWritten(uint16_t addr) {
+        patternStale[(addr >> 4) & 0xFF] = 1;
+        patternsDirty = true;
+    }
+
+    bool has(int table, int column, int row) const { return tiles[table][row * COLUMNS + column] != NO_TILE; }
+    // `rows` are the tile's decoded pattern rows (chr_cache.h), `palette` its attribute bits
+    void draw(int table, int column, int row, uint8_t tileId, uint8_t palette, const uint16_t rows[8]);
+
+    // `count` pixels of line y of the table pair `vertical` (0: $2000/$2400, 1: $2800/$2C00)
+    // from x (0-511), wrapping from the right table back into the left one.
+    void copy(int vertical, int y, int x, uint8_t* out, int count) const;
+
+    uint64_t tilesDrawn = 0;
+
+private:
+    static constexpr uint16_t NO_TILE = 0xFFFF;
+
+    uint8_t pixels[TABLES / 2][HEIGHT][PAIR_WIDTH];
+    uint16_t tiles[TABLES][ROWS * COLUMNS]; // Tile number each was drawn with, or NO_TILE
+    uint16_t patternBase = 0;
+    uint8_t patternStale[256];
+    bool patternsDirty = false;
+
+    void sweepPatterns();
+};
+
+#endif
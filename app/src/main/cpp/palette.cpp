@@ -0,0 +1,74 @@
+#include "palette.h"
+#include <cstring>
+
+namespace {
+
+// Each set emphasis bit darkens the two channels it does not name (bit 0 red,
+// bit 1 green, bit 2 blue), about a quarter, as measured on NTSC consoles.
+constexpr float EMPHASIS_ATTENUATION = 0.746f;
+
+uint32_t packColor(PixelFormat format, uint8_t r, uint8_t g, uint8_t b) {
+    switch (format) {
+        case PixelFormat::ABGR8888: return 0xFF000000u | (b << 16) | (g << 8) | r;
+        case PixelFormat::RGB565:   return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3);
+        case PixelFormat::XRGB8888: return (r << 16) | (g << 8) | b;
+        default:                    return 0xFF000000u | (r << 16) | (g << 8) | b;
+    }
+}
+
+} // namespace
+
+void DisplayPalette::generate() {
+    for (int i = 0; i < 64; i++) {
+        rgb[i][0] = (uint8_t)(nesPalette[i] >> 16);
+        rgb[i][1] = (uint8_t)(nesPalette[i] >> 8);
+        rgb[i][2] = (uint8_t)nesPalette[i];
+    }
+    synthesizeEmphasis();
+    build();
+}
+
+bool DisplayPalette::load(const uint8_t* data, size_t size) {
+    if (!data) return false;
+    if (size == 64 * 3) {
+        memcpy(rgb, data, size);
+        synthesizeEmphasis();
+    } else if (size == ENTRIES * 3) {
+        memcpy(rgb, data, size);
+    } else {
+        return false;
+    }
+    build();
+    return true;
+}
+
+void DisplayPalette::setFormat(PixelFormat pixelFormat) {
+    if (pixelFormat >= PixelFormat::Count) return;
+    format = pixelFormat;
+    build();
+}
+
+void DisplayPalette::synthesizeEmphasis() {
+    for (int e = 1; e < 8; e++) {
+        float scale[3] = {1.0f, 1.0f, 1.0f};
+        for (int bit = 0; bit < 3; bit++) {
+            if (!(e & (1 << bit))) continue;
+            for (int c = 0; c < 3; c++) {
+                if (c != bit) scale[c] *= EMPHASIS_ATTENUATION;
+            }
+        }
+        for (int i = 0; i < 64; i++) {
+            for (int c = 0; c < 3; c++) rgb[e * 64 + i][c] = (uint8_t)(rgb[i][c] * scale[c] + 0.5f);
+        }
+    }
+}
+
+void DisplayPalette::build() {
+    for (int i = 0; i < ENTRIES; i++) {
+        uint32_t color = packColor(format, rgb[i][0], rgb[i][1], rgb[i][2]);
+        if (format == PixelFormat::RGB565) colors16[i] = (uint16_t)color;
+        else colors[i] = color;
+    }
+    colors16[ENTRIES] = colors16[ENTRIES + 1] = 0;
+    version++;
+}
@@ -1,7 +1,16 @@
+/*
+ * Palette Module
+ * Responsibility: The NES system palette and its display form: a 512-entry
+ * (emphasis x index) color table in the active output pixel format, loaded from a
+ * standard .pal file or generated from the built-in colors. Everything here runs at
+ * configuration time; per pixel, output is one load from the finished table.
+ */
+
 #ifndef PALETTE_H
 #define PALETTE_H
 
 #include <cstdint>
+#include <cstddef>
 
 // NES System Palette (64 colors) as RGBX8888
 // NES System Palette (64 colors) as RGBX8888
@@ -16,4 +25,38 @@ static const uint32_t nesPalette[64] = {
     0xFFE4E594, 0xFFCFEF96, 0xFFBDF4AB, 0xFFB3F3CC, 0xFFB3EDF2, 0xFFB8B8B8, 0xFF000000, 0xFF000000
 };
 
+// Output pixel formats, named by component order from the most significant bit.
+enum class PixelFormat : uint8_t {
+    ARGB8888, // Android Bitmap.setPixels(int[])
+    ABGR8888, // R,G,B,A in memory: Bitmap.copyPixelsFromBuffer, GL_RGBA
+    RGB565,
+    XRGB8888, // Alpha byte left 0 for sinks that ignore it
+    Count
+};
+
+struct DisplayPalette {
+    static constexpr int ENTRIES = 512; // emphasis (PPUMASK bits 5-7) * 64 + index
+
+    uint8_t rgb[ENTRIES][3];          // Source colors
+    PixelFormat format = PixelFormat::ARGB8888;
+    uint32_t version = 0;             // Bumped whenever the table changes
+    alignas(32) uint32_t colors[ENTRIES];   // 32-bit formats
+    alignas(32) uint16_t colors16[ENTRIES + 2]; // RGB565; the slack keeps 32-bit gathers in bounds
+
+    DisplayPalette() { generate(); }
+
+    // Built-in colors (nesPalette), emphasis synthesized.
+    void generate();
+    // A .pal file: 64 RGB triplets (emphasis synthesized) or 512 (emphasis-major).
+    // Anything else is rejected and leaves the palette unchanged.
+    bool load(const uint8_t* data, size_t size);
+    void setFormat(PixelFormat pixelFormat);
+
+    int bytesPerPixel() const { return format == PixelFormat::RGB565 ? 2 : 4; }
+
+private:
+    void synthesizeEmphasis(); // Entries 64-511 from the first 64
+    void build();              // rgb -> the table of the active format
+};
+
 #endif
@@ -1,41 +1,117 @@
 #include "ppu.h"
 #include <cstring>
+#include <algorithm>
 #include <android/log.h>
 #include "cpu.h"
 #include "mapper.h"
-#include "palette.h"
 #include "renderer.h"
+#include "compositor.h"
+#include "deferred_ppu.h"
 
 void PPU::reset() {
     memset(paletteTable, 0, sizeof(paletteTable));
     memset(sprites, 0, sizeof(sprites));
     memset(secondaryOAM, 0xFF, sizeof(secondaryOAM));
+    memset(spriteLine, 0, sizeof(spriteLine));
+    spriteBucketsValid = false;
     
     spriteCount = 0;
     sprite0InSecondary = false;
     spriteOverflow = false;
     oddFrame = false;
     
-    bgShiftPatternLo = 0;
-    bgShiftPatternHi = 0;
-    bgShiftAttrLo = 0;
-    bgShiftAttrHi = 0;
+    bgShiftPixels = 0;
+    bgShiftPalettes = 0;
     
     bgNextTileId = 0;
     bgNextTileAttr = 0;
-    bgNextTileLo = 0;
-    bgNextTileHi = 0;
+    bgNextTileRow = 0;
 
     scanline = 0;
     cycle = 0;
     ppuctrl = 0;
     ppumask = 0;
+    selectPixelKernel();
     ppustatus = 0;
     vramAddr = 0;
     tempAddr = 0;
     fineX = 0;
     writeToggle = false;
-    nmiOccurred = false;
+
+    for (FrameRecord& record : frameRecords) record.valid = false;
+    recording = nullptr;
+    elided = nullptr;
+    generation++;
+    if (nametables) nametables->invalidateAll();
+}
+
+void PPU::setNametableCache(bool enabled) {
+    if (enabled && !nametables) nametables.reset(new NametableCache());
+    else if (!enabled) nametables.reset();
+}
+
+void PPU::setOutput(FrameQueue* target) {
+    frames = target;
+    for (FrameRecord& record : frameRecords) record.valid = false;
+    recording = nullptr;
+    // A frame being skipped has no picture for the new output: draw it so far
+    if (elided) resumeRendering();
+}
+
+// Field by field: the connections (mapper, chr, pages, cpu, scheduler, frames, writeLog)
+// stay as they are. A skipped frame is rendered first so the state is the real one.
+void PPU::copyState(PPU& source) {
+    if (source.elided) source.resumeRendering();
+    memcpy(paletteTable, source.paletteTable, sizeof(paletteTable));
+    memcpy(sprites, source.sprites, sizeof(sprites));
+    memcpy(secondaryOAM, source.secondaryOAM, sizeof(secondaryOAM));
+    memcpy(spriteLine, source.spriteLine, sizeof(spriteLine));
+    spriteCount = source.spriteCount;
+    spriteBucketsValid = false;
+    sprite0InSecondary = source.sprite0InSecondary;
+    spriteOverflow = source.spriteOverflow;
+    syncedCycle = source.syncedCycle;
+
+    ppuctrl = source.ppuctrl;
+    ppumask = source.ppumask;
+    ppustatus = source.ppustatus;
+    selectPixelKernel();
+    scanline = source.scanline;
+    cycle = source.cycle;
+    oddFrame = source.oddFrame;
+    oamAddr = source.oamAddr;
+    nmiPrevious = source.nmiPrevious;
+    vramAddr = source.vramAddr;
+    tempAddr = source.tempAddr;
+    fineX = source.fineX;
+    writeToggle = source.writeToggle;
+    readBuffer = source.readBuffer;
+
+    bgShiftPixels = source.bgShiftPixels;
+    bgShiftPalettes = source.bgShiftPalettes;
+    bgNextTileId = source.bgNextTileId;
+    bgNextTileAttr = source.bgNextTileAttr;
+    bgNextTileRow = source.bgNextTileRow;
+
+    frameElision = source.frameElision;
+    for (FrameRecord& record : frameRecords) record.valid = false;
+    recording = nullptr;
+    elided = nullptr;
+    frameSkipDot = source.frameSkipDot;
+    frameOddStart = source.frameOddStart;
+    generation++;
+    setNametableCache(false);
+    setNametableCache(source.nametables != nullptr);
+}
+
+void PPU::writeOam(const uint8_t* data) {
+    if (writeLog) writeLog->oam(syncedCycle, data);
+    // Most games copy the same sprites every frame: only a real change counts
+    if (memcmp(sprites, data, sizeof(sprites)) != 0) {
+        bumpGeneration();
+        memcpy(sprites, data, sizeof(sprites));
+        spriteBucketsValid = false;
+    }
 }
 
 uint8_t PPU::readStatus() {
@@ -45,7 +121,7 @@ uint8_t PPU::readStatus() {
     // it's cleared in the result and NMI is suppressed for this frame.
     if (scanline == 241 && cycle == 1) {
         res &= ~0x80;
-        nmiOccurred = false; 
+        if (cpu) cpu->nmiPending = false;
     }
     
     ppustatus &= ~0x80;
@@ -53,21 +129,73 @@ uint8_t PPU::readStatus() {
     return res;
 }
 
+// Dots from the current position until (line, dot) is processed. Wrapping assumes
+// the short odd frame, so the answer may be one dot early but never late.
+int PPU::dotsUntil(int line, int dot) const {
+    static constexpr int DOTS_PER_LINE = 341;
+    static constexpr int FRAME_DOTS = 262 * DOTS_PER_LINE - 1;
+    int d = line * DOTS_PER_LINE + dot - (scanline * DOTS_PER_LINE + cycle);
+    return d > 0 ? d : d + FRAME_DOTS;
+}
+
+void PPU::raiseNmi() {
+    if (cpu) cpu->nmiPending = true;
+}
+
+void PPU::catchUp(uint64_t cpuCycle) {
+    if (cpuCycle > syncedCycle) runDots((int)(cpuCycle - syncedCycle) * 3);
+    syncedCycle = cpuCycle;
+    if (scheduler) scheduler->schedule(Event::VBlank, syncedCycle + (dotsUntil(241, 1) + 2) / 3);
+}
+
+// Dots until PPUSTATUS may next read differently: vblank set/clear, and the dots
+// where sprite 0 hit or sprite overflow could be raised. May answer early, never late.
+int PPU::dotsUntilStatusChange() const {
+    int best = std::min(dotsUntil(241, 1), dotsUntil(261, 1));
+    const int height = (ppuctrl & 0x20) ? 16 : 8;
+
+    // Sprite 0 hit: only on the lines sprite 0 covers, dots 1-256
+    if ((ppumask & 0x18) == 0x18 && !(ppustatus & 0x40)) {
+        if (sprite0InSecondary && scanline < 240) return 0;
+        int first = std::max<int>(sprites[0].y, 1);
+        int last = std::min<int>(sprites[0].y + height - 1, 239);
+        if (first <= last) {
+            if (scanline >= first && scanline <= last) return 0;
+            best = std::min(best, dotsUntil(first, 1));
+        }
+    }
+
+    // Sprite overflow: evaluation at dot 257 needs 8 sprites in range of the next line
+    if (!(ppustatus & 0x20)) {
+        uint8_t inRange[240] = {0};
+        for (int n = 0; n < 64; n++) {
+            int top = sprites[n].y;
+            for (int line = std::max(top, 1); line < std::min(top + height, 240); line++) inRange[line]++;
+        }
+        for (int line = 1; line < 240; line++) {
+            if (inRange[line] >= 8) best = std::min(best, dotsUntil(line - 1, 257));
+        }
+    }
+    return best;
+}
+
 uint8_t PPU::readRegister(uint16_t addr) {
     uint16_t reg = 0x2000 + (addr % 8);
+    if (writeLog && (reg == 0x2002 || reg == 0x2007)) writeLog->read(syncedCycle, reg);
     switch (reg) {
         case 0x2002: return readStatus();
         case 0x2004: return 0; // OAMDATA read not implemented
         case 0x2007: {
+            if (elided) resumeRendering();
             uint8_t data = vramRead(vramAddr);
             if (vramAddr < 0x3F00) {
                 uint8_t buffered = readBuffer;
                 readBuffer = data;
                 data = buffered;
             } else {
-                readBuffer = mapper ? mapper->ppuRead(vramAddr - 0x1000) : 0;
+                readBuffer = vramRead(vramAddr - 0x1000); // The nametable byte under the palette
             }
-            vramAddr += (ppuctrl & 0x04) ? 32 : 1;
+            moveVramAddr(vramAddr + ((ppuctrl & 0x04) ? 32 : 1));
             return data;
         }
         default: return 0;
@@ -76,78 +204,320 @@ uint8_t PPU::readRegister(uint16_t addr) {
 
 void PPU::writeRegister(uint16_t addr, uint8_t val) {
     uint16_t reg = 0x2000 + (addr % 8);
+    if (writeLog) writeLog->write(syncedCycle, reg, val);
     switch (reg) {
         case 0x2000: {
             uint8_t oldCtrl = ppuctrl;
+            uint16_t t = (tempAddr & 0xF3FF) | ((val & 0x03) << 10);
+            if (val != ppuctrl || t != tempAddr) changeScroll();
             ppuctrl = val;
             if (!(oldCtrl & 0x80) && (val & 0x80) && (ppustatus & 0x80)) {
-                nmiOccurred = true;
+                raiseNmi();
             }
-            tempAddr = (tempAddr & 0xF3FF) | ((val & 0x03) << 10);
+            tempAddr = t;
+            break;
+        }
+        case 0x2001: {
+            if (val != ppumask) changeScroll();
+            ppumask = val;
+            selectPixelKernel();
             break;
         }
-        case 0x2001: ppumask = val; break;
         case 0x2003: oamAddr = val; break;
         case 0x2004: {
-            ((uint8_t*)sprites)[oamAddr++] = val;
+            uint8_t& entry = ((uint8_t*)sprites)[oamAddr++];
+            if (entry != val) {
+                bumpGeneration();
+                entry = val;
+                spriteBucketsValid = false;
+            }
             break;
         }
         case 0x2005: {
+            uint16_t t = tempAddr;
+            uint8_t x = fineX;
             if (!writeToggle) {
-                tempAddr = (tempAddr & 0xFFE0) | (val >> 3);
-                fineX = val & 0x07;
+                t = (t & 0xFFE0) | (val >> 3);
+                x = val & 0x07;
             } else {
-                tempAddr = (tempAddr & 0x8FFF) | ((val & 0x07) << 12);
-                tempAddr = (tempAddr & 0xFC1F) | ((val & 0xF8) << 2);
+                t = (t & 0x8FFF) | ((val & 0x07) << 12);
+                t = (t & 0xFC1F) | ((val & 0xF8) << 2);
             }
+            if (t != tempAddr || x != fineX) changeScroll();
+            tempAddr = t;
+            fineX = x;
             writeToggle = !writeToggle;
             break;
         }
         case 0x2006: {
             if (!writeToggle) {
-                tempAddr = (tempAddr & 0x00FF) | ((val & 0x3F) << 8);
+                uint16_t t = (tempAddr & 0x00FF) | ((val & 0x3F) << 8);
+                if (t != tempAddr) changeScroll();
+                tempAddr = t;
             } else {
-                tempAddr = (tempAddr & 0xFF00) | val;
-                vramAddr = tempAddr;
+                uint16_t t = (tempAddr & 0xFF00) | val;
+                if (t != tempAddr) changeScroll();
+                tempAddr = t;
+                moveVramAddr(tempAddr);
             }
             writeToggle = !writeToggle;
             break;
         }
         case 0x2007: {
+            if (elided) resumeRendering();
             vramWrite(vramAddr, val);
-            vramAddr += (ppuctrl & 0x04) ? 32 : 1;
+            moveVramAddr(vramAddr + ((ppuctrl & 0x04) ? 32 : 1));
             break;
         }
     }
 }
 
-void PPU::step(int cpuCycles, CPU* cpu) {
-    int ppuCycles = cpuCycles * 3;
-    for (int i = 0; i < ppuCycles; i++) {
-        // Odd Frame Skip
-        if (scanline == 261 && cycle == 339 && oddFrame && (ppumask & 0x18)) {
-            cycle = 0;
+void PPU::runDots(int dots) {
+    while (dots > 0) {
+        if (scanline == 260 && cycle == 340 && !elided) beginFrame();
+        if (elided) {
+            dots -= skipElided(dots);
+            continue;
+        }
+        if ((ppumask & 0x18) && (scanline < 240 || scanline == 261)) {
+            if (scanline < 240 && cycle == 0 && dots >= 341) {
+                // Nothing can touch the PPU before this line ends
+                renderScanline();
+                dots -= 341;
+            } else {
+                // Line split by a catch-up boundary (or pre-render): per-dot pipeline
+                int run = std::min(dots, 341 - cycle);
+                for (int i = 0; i < run; i++) tick();
+                dots -= run;
+            }
+        } else {
+            dots -= skipIdle(dots);
+        }
+        if (recording && scanline == 240 && cycle == 0) endFrame();
+    }
+}
+
+// --- Static-frame elision ---
+
+void PPU::bumpGeneration() {
+    if (elided) resumeRendering();
+    generation++;
+}
+
+// Scroll and control changes between frames are caught by the start-state comparison;
+// inside one they change what the rest of it shows.
+void PPU::changeScroll() {
+    if (elided || scanline < 240 || scanline == 261) bumpGeneration();
+}
+
+void PPU::moveVramAddr(uint16_t addr) {
+    if (elided || addr != vramAddr) changeScroll();
+    vramAddr = addr;
+}
+
+int PPU::frameDot(int line, int dot) const {
+    static constexpr int DOTS_PER_LINE = 341;
+    if (line == 261) return dot;
+    return DOTS_PER_LINE - frameSkipDot + line * DOTS_PER_LINE + dot;
+}
+
+void PPU::captureState(RenderState& state) const {
+    memset(&state, 0, sizeof(state)); // Padding too: states are compared with memcmp
+    state.tempAddr = tempAddr;
+    state.ppuctrl = ppuctrl;
+    state.ppumask = ppumask;
+    state.fineX = fineX;
+    state.bgShiftPixels = bgShiftPixels;
+    state.bgShiftPalettes = bgShiftPalettes;
+    state.vramAddr = vramAddr;
+    state.bgNextTileRow = bgNextTileRow;
+    state.bgNextTileId = bgNextTileId;
+    state.bgNextTileAttr = bgNextTileAttr;
+    state.spriteCount = spriteCount;
+    state.sprite0InSecondary = sprite0InSecondary;
+    memcpy(state.secondaryOAM, secondaryOAM, sizeof(secondaryOAM));
+    memcpy(state.spriteLine, spriteLine, sizeof(spriteLine));
+}
+
+void PPU::restoreState(const RenderState& state) { // Registers are equal already
+    bgShiftPixels = state.bgShiftPixels;
+    bgShiftPalettes = state.bgShiftPalettes;
+    vramAddr = state.vramAddr;
+    bgNextTileRow = state.bgNextTileRow;
+    bgNextTileId = state.bgNextTileId;
+    bgNextTileAttr = state.bgNextTileAttr;
+    spriteCount = state.spriteCount;
+    sprite0InSecondary = state.sprite0InSecondary;
+    memcpy(secondaryOAM, state.secondaryOAM, sizeof(secondaryOAM));
+    memcpy(spriteLine, state.spriteLine, sizeof(spriteLine));
+}
+
+// The frame runs from pre-render dot 0 to the end of line 239. The reference must be
+// of the same parity: the odd frame's skipped dot shifts the start of line 0.
+void PPU::beginFrame() {
+    FrameRecord& record = frameRecords[oddFrame];
+    frameSkipDot = (oddFrame && (ppumask & 0x18)) ? 1 : 0;
+    frameOddStart = oddFrame;
+    recording = nullptr;
+    if (replaying) return;
+    if (!frameElision || !(ppumask & 0x18)) {
+        record.valid = false;
+        return;
+    }
+
+    RenderState now;
+    captureState(now);
+    if (record.valid && record.generation == generation && (!frames || record.picture) &&
+        memcmp(&now, &record.start, sizeof(now)) == 0) {
+        elided = &record;
+        elidedDot = -1;
+        return;
+    }
+    record.valid = false;
+    record.generation = generation;
+    record.start = now;
+    record.eventCount = 0;
+    recording = &record;
+}
+
+void PPU::endFrame() {
+    captureState(recording->end);
+    bool drawn = true;
+    if (frames) {
+        if (!recording->picture) recording->picture.reset(new IndexedFrame());
+        drawn = frames->copyBack(*recording->picture);
+    }
+    recording->valid = drawn && recording->generation == generation;
+    recording = nullptr;
+}
+
+void PPU::raiseStatus(uint8_t bit, int line, int dot) {
+    if (ppustatus & bit) return;
+    ppustatus |= bit;
+    if (!recording) return;
+    if (recording->eventCount < 2) {
+        recording->events[recording->eventCount++] = {frameDot(line, dot), bit};
+    } else {
+        recording = nullptr; // Not expected: both flags are raised at most once a frame
+    }
+}
+
+// Only what tick() does to PPUSTATUS and the position: the flag clears at pre-render
+// dot 1 and at the wrap onto line 0, and the recorded flags on their dots.
+int PPU::skipElided(int maxDots) {
+    static constexpr int DOTS_PER_LINE = 341;
+    const int wrapDot = frameDot(0, 0);
+    const int endDot = frameDot(240, 0);
+
+    int next = endDot;
+    if (elidedDot < 1) next = 1;
+    else if (elidedDot < wrapDot) next = wrapDot;
+    for (int i = 0; i < elided->eventCount; i++) {
+        int dot = elided->events[i].dot;
+        if (dot > elidedDot && dot < next) next = dot;
+    }
+
+    int n = std::min(maxDots, next - elidedDot);
+    elidedDot += n;
+    if (elidedDot == 1) ppustatus &= ~0xE0;
+    if (elidedDot == wrapDot) {
+        oddFrame = !oddFrame;
+        ppustatus &= ~0xE0;
+    }
+    for (int i = 0; i < elided->eventCount; i++) {
+        if (elided->events[i].dot == elidedDot) ppustatus |= elided->events[i].bit;
+    }
+
+    if (elidedDot < wrapDot) {
+        scanline = 261;
+        cycle = elidedDot;
+    } else {
+        scanline = (elidedDot - wrapDot) / DOTS_PER_LINE;
+        cycle = (elidedDot - wrapDot) % DOTS_PER_LINE;
+    }
+    if (elidedDot == endDot) {
+        restoreState(elided->end);
+        if (frames) frames->fillBack(*elided->picture);
+        elided = nullptr;
+        framesElided++;
+    }
+    return n;
+}
+
+// PPUSTATUS is left alone: the redraw clears and raises the same flags on the same dots.
+void PPU::resumeRendering() {
+    int dots = elidedDot + 1; // Since (260, 340)
+    restoreState(elided->start);
+    elided = nullptr;
+    oddFrame = frameOddStart;
+    scanline = 260;
+    cycle = 340;
+    replaying = true;
+    runDots(dots);
+    replaying = false;
+}
+
+void PPU::tick() {
+    // Odd Frame Skip
+    if (scanline == 261 && cycle == 339 && oddFrame && (ppumask & 0x18)) {
+        cycle = 0;
+        scanline = 0;
+        oddFrame = !oddFrame;
+        ppustatus &= ~0xE0;
+        return;
+    }
+
+    cycle++;
+    if (cycle >= 341) {
+        cycle = 0;
+        scanline++;
+        if (scanline >= 262) {
             scanline = 0;
             oddFrame = !oddFrame;
             ppustatus &= ~0xE0;
-            continue;
         }
+    }
 
-        cycle++;
-        if (cycle >= 341) {
-            cycle = 0;
-            scanline++;
-            if (scanline >= 262) {
-                scanline = 0;
-                oddFrame = !oddFrame;
-                ppustatus &= ~0xE0;
-            }
+    processBackground();
+    processSprites();
+    handleVBlank();
+}
+
+// Rendering off, or outside the render lines: the only per-dot work left is the
+// secondary OAM clear (dots 2-64), sprite evaluation (dot 257) and the vblank edges.
+// Jumps in one step to the dot before the next of those, which then runs as a tick.
+int PPU::skipIdle(int maxDots) {
+    static constexpr int DOTS_PER_LINE = 341;
+    const bool renderLine = scanline < 240 || scanline == 261;
+    int stopLine = scanline, stopDot = DOTS_PER_LINE; // Line wrap runs as a tick
+    if (!renderLine) {
+        if (scanline < 241 || (scanline == 241 && cycle < 1)) {
+            stopLine = 241;
+            stopDot = 1;
+        } else {
+            stopLine = 261; // Pre-render dot 0 may already render
+            stopDot = 0;
         }
+    } else if (scanline == 261 && cycle < 1) {
+        stopDot = 1;
+    } else if (scanline < 239 && cycle < 257) {
+        stopDot = 257;
+    }
 
-        processBackground();
-        processSprites();
-        handleVBlank();
+    int now = scanline * DOTS_PER_LINE + cycle;
+    int n = std::min(maxDots, stopLine * DOTS_PER_LINE + stopDot - 1 - now);
+    if (n <= 0) {
+        tick();
+        return 1;
+    }
+    if (renderLine) {
+        int last = std::min(cycle + n, 64);
+        for (int d = (cycle + 2) & ~1; d <= last; d += 2) secondaryOAM[((d - 1) / 2) % 32] = 0xFF;
     }
+    now += n;
+    scanline = now / DOTS_PER_LINE;
+    cycle = now % DOTS_PER_LINE;
+    return n;
 }
 
 void PPU::processBackground() {
@@ -161,24 +531,11 @@ void PPU::processBackground() {
         
         if ((cycle >= 1 && cycle <= 256) || (cycle >= 321 && cycle <= 336)) {
             int step = (cycle - 1) % 8;
-            if (step == 1) {
-                uint16_t ntAddr = 0x2000 | (vramAddr & 0x0FFF);
-                bgNextTileId = vramRead(ntAddr);
-            }
-            if (step == 3) {
-                uint16_t atAddr = 0x23C0 | (vramAddr & 0x0C00) | ((vramAddr >> 4) & 0x38) | ((vramAddr >> 2) & 0x07);
-                bgNextTileAttr = vramRead(atAddr);
-                if (vramAddr & 0x0040) bgNextTileAttr >>= 4;
-                if (vramAddr & 0x0002) bgNextTileAttr >>= 2;
-                bgNextTileAttr &= 0x03;
-            }
-            if (step == 5) {
-                uint16_t patternAddr = ((ppuctrl & 0x10) ? 0x1000 : 0x0000) + ((uint16_t)bgNextTileId << 4) + ((vramAddr >> 12) & 0x07);
-                bgNextTileLo = vramRead(patternAddr);
-            }
+            if (step == 1) fetchNametable();
+            if (step == 3) fetchAttribute();
+            if (step == 5) fetchPatternLo();
             if (step == 7) {
-                uint16_t patternAddr = ((ppuctrl & 0x10) ? 0x1000 : 0x0000) + ((uint16_t)bgNextTileId << 4) + ((vramAddr >> 12) & 0x07) + 8;
-                bgNextTileHi = vramRead(patternAddr);
+                fetchPatternHi();
                 incrementX();
                 loadBackgroundShifters();
             }
@@ -200,54 +557,36 @@ void PPU::processSprites() {
         if (cycle % 2 == 0) secondaryOAM[idx] = 0xFF;
     }
     
-    // Cycle 257: Instant Sprite Evaluation & Pre-fetch for NEXT scanline
-    if (cycle == 257 && scanline < 239) { // We evaluate for scanline + 1
-        int nextScanline = scanline + 1;
-        spriteCount = 0;
-        sprite0InSecondary = false;
-        
-        int n = 0; 
-        int spriteHeight = (ppuctrl & 0x20) ? 16 : 8;
+    // Cycle 257: Instant Sprite Evaluation, Pre-fetch & Rasterization for NEXT scanline
+    if (cycle == 257 && scanline < 239) evaluateSprites();
+}
 
-        while (n < 64 && spriteCount < 8) {
-            int sy = sprites[n].y;
-            int diff = nextScanline - sy;
-            if (diff >= 0 && diff < spriteHeight) {
-                int secIdx = spriteCount * 4;
-                secondaryOAM[secIdx + 0] = sprites[n].y;
-                secondaryOAM[secIdx + 1] = sprites[n].tile_index;
-                secondaryOAM[secIdx + 2] = sprites[n].attributes;
-                secondaryOAM[secIdx + 3] = sprites[n].x;
-                
-                // Pre-fetch Pattern Data
-                int row = nextScanline - sy;
-                uint8_t sa = sprites[n].attributes;
-                uint8_t st = sprites[n].tile_index;
-                if (sa & 0x80) row = ((ppuctrl & 0x20) ? 15 : 7) - row;
-                
-                uint16_t patternBase = (ppuctrl & 0x08) ? 0x1000 : 0x0000;
-                if (ppuctrl & 0x20) {
-                    patternBase = (st & 1) ? 0x1000 : 0x0000;
-                    st &= 0xFE;
-                    if (row >= 8) { st++; row -= 8; }
-                }
-                
-                spriteFetchedLo[spriteCount] = vramRead(patternBase + (st * 16) + row);
-                spriteFetchedHi[spriteCount] = vramRead(patternBase + (st * 16) + row + 8);
-
-                if (n == 0) sprite0InSecondary = true;
-                spriteCount++;
-            }
-            n++;
+// OAM sorted into the lines it covers: each bucket keeps the first 8 sprites in OAM
+// order (all evaluation can take) and whether the overflow scan would trip on that line.
+void PPU::buildSpriteBuckets(int spriteHeight) {
+    for (SpriteBucket& bucket : spriteBuckets) {
+        bucket.count = 0;
+        bucket.overflow = false;
+    }
+    for (int n = 0; n < 64; n++) {
+        int top = sprites[n].y;
+        for (int line = top; line < std::min(top + spriteHeight, 240); line++) {
+            SpriteBucket& bucket = spriteBuckets[line];
+            if (bucket.count < 8) bucket.index[bucket.count++] = n;
         }
+    }
 
-        // Sprite Overflow
+    // Sprite Overflow: the hardware's diagonal scan from the sprite after the 8th
+    for (int line = 0; line < 240; line++) {
+        SpriteBucket& bucket = spriteBuckets[line];
+        if (bucket.count < 8) continue;
+        int n = bucket.index[7] + 1;
         int m = 0;
         while (n < 64) {
             int y = ((uint8_t*)sprites)[n * 4 + m];
-            int diff = nextScanline - y;
+            int diff = line - y;
             if (diff >= 0 && diff < spriteHeight) {
-                ppustatus |= 0x20;
+                bucket.overflow = true;
                 break;
             } else {
                 n++;
@@ -255,12 +594,68 @@ void PPU::processSprites() {
             }
         }
     }
+
+    bucketHeight = spriteHeight;
+    spriteBucketsValid = true;
+}
+
+void PPU::evaluateSprites() {
+    int nextScanline = scanline + 1;
+    spriteCount = 0;
+    sprite0InSecondary = false;
+    memset(spriteLine, 0, sizeof(spriteLine));
+    
+    int spriteHeight = (ppuctrl & 0x20) ? 16 : 8;
+    if (!spriteBucketsValid || bucketHeight != spriteHeight) buildSpriteBuckets(spriteHeight);
+    const SpriteBucket& bucket = spriteBuckets[nextScanline];
+
+    for (int i = 0; i < bucket.count; i++) {
+        int n = bucket.index[i];
+        int sy = sprites[n].y;
+        int secIdx = spriteCount * 4;
+        secondaryOAM[secIdx + 0] = sprites[n].y;
+        secondaryOAM[secIdx + 1] = sprites[n].tile_index;
+        secondaryOAM[secIdx + 2] = sprites[n].attributes;
+        secondaryOAM[secIdx + 3] = sprites[n].x;
+        
+        // Pre-fetch Pattern Data
+        int row = nextScanline - sy;
+        uint8_t sa = sprites[n].attributes;
+        uint8_t st = sprites[n].tile_index;
+        if (sa & 0x80) row = ((ppuctrl & 0x20) ? 15 : 7) - row;
+        
+        uint16_t patternBase = (ppuctrl & 0x08) ? 0x1000 : 0x0000;
+        if (ppuctrl & 0x20) {
+            patternBase = (st & 1) ? 0x1000 : 0x0000;
+            st &= 0xFE;
+            if (row >= 8) { st++; row -= 8; }
+        }
+        
+        uint16_t pixels = patternRow(patternBase + (st * 16) + row, sa & 0x40);
+        uint8_t flags = ((sa & 0x03) << 2) | (sa & SPRITE_BEHIND) | (spriteCount == 0 ? SPRITE_SLOT0 : 0);
+        rasterizeSprite(sprites[n].x, pixels, flags);
+
+        if (n == 0) sprite0InSecondary = true;
+        spriteCount++;
+    }
+
+    if (bucket.overflow) raiseStatus(0x20, scanline, 257);
+}
+
+// Sprites arrive front to back, so a pixel already taken keeps its owner
+void PPU::rasterizeSprite(int x, uint16_t pixels, uint8_t flags) {
+    int end = std::min(x + 8, 256);
+    for (int px = x; px < end; px++, pixels <<= 2) {
+        uint8_t pixel = pixels >> 14;
+        if (pixel && !(spriteLine[px] & SPRITE_PIXEL)) spriteLine[px] = flags | pixel;
+    }
 }
 
 void PPU::handleVBlank() {
     if (scanline == 241 && cycle == 1) {
         ppustatus |= 0x80;
-        if (ppuctrl & 0x80) nmiOccurred = true;
+        if (ppuctrl & 0x80) raiseNmi();
+        if (frames) frames->publish(); // The picture is complete
     }
     
     if (scanline == 261 && cycle == 1) {
@@ -272,7 +667,7 @@ void PPU::handleVBlank() {
 uint8_t PPU::vramRead(uint16_t addr) {
     addr &= 0x3FFF;
     if (addr < 0x3F00) {
-        return mapper ? mapper->ppuRead(addr) : 0;
+        return pages.read(addr);
     } else {
         uint16_t paletteAddr = addr & 0x001F;
         if (paletteAddr >= 0x10 && (paletteAddr & 0x03) == 0) paletteAddr -= 0x10;
@@ -280,10 +675,20 @@ uint8_t PPU::vramRead(uint16_t addr) {
     }
 }
 
+uint16_t PPU::patternRow(uint16_t addr, bool flip) {
+    return chr ? chr->row(addr & 0x1FFF, flip) : 0;
+}
+
 void PPU::vramWrite(uint16_t addr, uint8_t val) {
     addr &= 0x3FFF;
+    if (vramRead(addr) != val) {
+        bumpGeneration();
+        if (nametables && addr < 0x2000) nametables->patternWritten(addr);
+        else if (nametables && addr < 0x3F00) nametables->nametableWritten(addr);
+    }
     if (addr < 0x3F00) {
         if (mapper) mapper->ppuWrite(addr, val);
+        if (writeLog) writeLog->poke(syncedCycle, addr, vramRead(addr));
     } else {
         uint16_t paletteAddr = addr & 0x001F;
         if (paletteAddr >= 0x10 && (paletteAddr & 0x03) == 0) paletteAddr -= 0x10;
@@ -333,47 +738,212 @@ void PPU::copyY() {
 }
 
 void PPU::loadBackgroundShifters() {
-    bgShiftPatternLo = (bgShiftPatternLo & 0xFF00) | bgNextTileLo;
-    bgShiftPatternHi = (bgShiftPatternHi & 0xFF00) | bgNextTileHi;
+    bgShiftPixels = (bgShiftPixels & 0xFFFF0000) | bgNextTileRow;
     
-    // Attributes handling: Expand 2-bit attribute to 8 bits for the next 8 pixels
-    bgShiftAttrLo = (bgShiftAttrLo & 0xFF00) | ((bgNextTileAttr & 1) ? 0x00FF : 0x0000);
-    bgShiftAttrHi = (bgShiftAttrHi & 0xFF00) | ((bgNextTileAttr & 2) ? 0x00FF : 0x0000);
+    // Attributes handling: Expand 2-bit attribute to 8 pixels
+    bgShiftPalettes = (bgShiftPalettes & 0xFFFF0000) | (bgNextTileAttr * 0x5555);
+}
+
+// Background fetches, one per odd dot of each 8-dot slot; all read through v
+void PPU::fetchNametable() {
+    uint16_t ntAddr = 0x2000 | (vramAddr & 0x0FFF);
+    bgNextTileId = vramRead(ntAddr);
+}
+
+void PPU::fetchAttribute() {
+    uint16_t atAddr = 0x23C0 | (vramAddr & 0x0C00) | ((vramAddr >> 4) & 0x38) | ((vramAddr >> 2) & 0x07);
+    bgNextTileAttr = vramRead(atAddr);
+    if (vramAddr & 0x0040) bgNextTileAttr >>= 4;
+    if (vramAddr & 0x0002) bgNextTileAttr >>= 2;
+    bgNextTileAttr &= 0x03;
+}
+
+// Decoded rows interleave the planes: bit 0 of each pixel (even bits) is the low plane
+void PPU::fetchPatternLo() {
+    uint16_t patternAddr = ((ppuctrl & 0x10) ? 0x1000 : 0x0000) + ((uint16_t)bgNextTileId << 4) + ((vramAddr >> 12) & 0x07);
+    bgNextTileRow = patternRow(patternAddr, false) & 0x5555;
+}
+
+void PPU::fetchPatternHi() {
+    uint16_t patternAddr = ((ppuctrl & 0x10) ? 0x1000 : 0x0000) + ((uint16_t)bgNextTileId << 4) + ((vramAddr >> 12) & 0x07);
+    bgNextTileRow = (bgNextTileRow & 0x5555) | (patternRow(patternAddr, false) & 0xAAAA);
+}
+
+// Both planes of the slot in one lookup: only valid where CHR cannot change mid-slot
+void PPU::fetchPattern() {
+    uint16_t patternAddr = ((ppuctrl & 0x10) ? 0x1000 : 0x0000) + ((uint16_t)bgNextTileId << 4) + ((vramAddr >> 12) & 0x07);
+    bgNextTileRow = patternRow(patternAddr, false);
+}
+
+// v only moves after the last fetch of a slot, so they can run back to back
+void PPU::fetchTile() {
+    fetchNametable();
+    fetchAttribute();
+    fetchPattern();
+}
+
+void PPU::shiftBackground(int n) {
+    if (n >= 16) {
+        bgShiftPixels = bgShiftPalettes = 0;
+        return;
+    }
+    bgShiftPixels <<= 2 * n;
+    bgShiftPalettes <<= 2 * n;
 }
 
 void PPU::updateShifters() {
     if (ppumask & 0x18) { // If rendering enabled
-        bgShiftPatternLo <<= 1;
-        bgShiftPatternHi <<= 1;
-        bgShiftAttrLo <<= 1;
-        bgShiftAttrHi <<= 1;
+        bgShiftPixels <<= 2;
+        bgShiftPalettes <<= 2;
+    }
+}
+
+// Visible line with rendering on, entered at dot 0 with the whole line owed: the same
+// fetch/shift/evaluate schedule as tick(), batched per 8-dot slot. Any register access
+// catches the PPU up first, so a line something can observe midway goes through tick()
+// and sprite 0 hit / overflow still land on their own dot for every PPUSTATUS read.
+void PPU::renderScanline() {
+    // Dots 1-256: each slot shows the 8 pixels at the top of the shifters (offset by
+    // fine X) while its tile is fetched, then shifts them out and reloads
+    uint8_t bgLine[256];
+    const bool hitPossible = sprite0InSecondary && (ppumask & 0x18) == 0x18 && !(ppustatus & 0x40);
+    if (!frames && !hitPossible) {
+        vramAddr ^= 0x0400; // Nothing to draw or test: only v outlives the fetches
+    } else if (nametables && (ppumask & 0x08) && ((vramAddr >> 5) & 0x1F) < NametableCache::ROWS) {
+        backgroundFromCache(bgLine);
+    } else {
+        const int window = 14 - 2 * fineX;
+        for (int slot = 0; slot < 32; slot++) {
+            fetchTile();
+            uint32_t pixels = bgShiftPixels >> window;
+            uint32_t palettes = bgShiftPalettes >> window;
+            for (int i = 0; i < 8; i++) {
+                int shift = 14 - 2 * i;
+                bgLine[slot * 8 + i] = (((palettes >> shift) & 3) << 2) | ((pixels >> shift) & 3);
+            }
+            shiftBackground(8);
+            incrementX();
+            loadBackgroundShifters();
+        }
+    }
+    incrementY();
+    if (frames || hitPossible) composeLine(bgLine);
+
+    // Dot 257: reload horizontal v; secondary OAM was cleared over dots 1-64
+    shiftBackground(1);
+    copyX();
+    memset(secondaryOAM, 0xFF, sizeof(secondaryOAM));
+    if (scanline < 239) evaluateSprites();
+    shiftBackground(63); // Dots 258-320
+
+    // Dots 321-336: first two tiles of the next line
+    for (int slot = 0; slot < 2; slot++) {
+        fetchTile();
+        shiftBackground(8);
+        incrementX();
+        loadBackgroundShifters();
+    }
+    shiftBackground(4); // Dots 337-340
+
+    // Wrap onto dot 0 of the next line
+    cycle = 0;
+    scanline++;
+    if (scanline < 240) shiftBackground(1);
+}
+
+// The line's pixels as the slot loop would produce them: the first 15 - fine X from
+// the shifters (the tiles prefetched on the previous line), then a scrolled copy of the
+// row of the tables that v points at, starting with the tile at v. The fetches the copy
+// replaces would have left the shifters and latches to be overwritten before they are
+// read again, so only v is advanced (32 x incrementX: the next horizontal table).
+void PPU::backgroundFromCache(uint8_t* bgLine) {
+    nametables->begin((ppuctrl & 0x10) ? 0x1000 : 0x0000);
+    const int vertical = (vramAddr >> 11) & 1;
+    const int row = (vramAddr >> 5) & 0x1F;
+    const int start = ((vramAddr >> 10) & 1) * 32 + (vramAddr & 0x1F); // Column across the pair
+    for (int i = 0; i < 31; i++) {
+        int column = (start + i) & 63;
+        int table = vertical * 2 + (column >> 5);
+        if (!nametables->has(table, column & 31, row)) drawCachedTile(table, column & 31, row);
+    }
+
+    const int shifted = 15 - fineX;
+    for (int x = 0; x < shifted; x++) {
+        int shift = 28 - 2 * (x + fineX);
+        bgLine[x] = (((bgShiftPalettes >> shift) & 3) << 2) | ((bgShiftPixels >> shift) & 3);
     }
+    nametables->copy(vertical, row * 8 + ((vramAddr >> 12) & 7), start * 8, bgLine + shifted, 256 - shifted);
+    vramAddr ^= 0x0400;
 }
 
-void PPU::renderPixel() {
+// The same reads as fetchNametable() / fetchAttribute() / fetchPattern() at that tile
+void PPU::drawCachedTile(int table, int column, int row) {
+    uint16_t base = 0x2000 | (table << 10);
+    uint8_t id = vramRead(base | (row << 5) | column);
+    uint8_t attr = vramRead(base | 0x03C0 | ((row >> 2) << 3) | (column >> 2));
+    attr = (attr >> (((row & 2) << 1) | (column & 2))) & 0x03;
+    uint16_t pattern = ((ppuctrl & 0x10) ? 0x1000 : 0x0000) + ((uint16_t)id << 4);
+    uint16_t rows[8];
+    for (int r = 0; r < 8; r++) rows[r] = patternRow(pattern + r, false);
+    nametables->draw(table, column, row, id, attr, rows);
+}
+
+// renderPixel() for a whole line: enables and clipping applied to both layers, sprite 0
+// hit, then the mux and color lookups in compositor.h
+void PPU::composeLine(uint8_t* bgLine) {
+    static const uint8_t noSprites[256] = {0};
+    uint8_t clippedSprites[256];
+    const uint8_t* sprLine = spriteLine;
+
+    if (!(ppumask & 0x08)) memset(bgLine, 0, 256);
+    else if (!(ppumask & 0x02)) memset(bgLine, 0, 8);
+    if (!(ppumask & 0x10)) {
+        sprLine = noSprites;
+    } else if (!(ppumask & 0x04)) {
+        memcpy(clippedSprites, spriteLine, sizeof(clippedSprites));
+        memset(clippedSprites, 0, 8);
+        sprLine = clippedSprites;
+    }
+
+    // Sprite 0 Hit: the PPU is not observable until the line ends, so any dot will do
+    if (sprite0InSecondary && (ppumask & 0x18) == 0x18 && !(ppustatus & 0x40)) {
+        for (int x = 0; x < 255; x++) {
+            if ((sprLine[x] & SPRITE_SLOT0) && (bgLine[x] & 0x03)) {
+                raiseStatus(0x40, scanline, x + 1);
+                break;
+            }
+        }
+    }
+
+    if (frames) {
+        uint8_t colors[32];
+        buildLineColors(paletteTable, ppumask & 0x01, colors);
+        composeScanline(bgLine, sprLine, colors, frames->row(scanline, true), SCREEN_WIDTH);
+        frames->setEmphasis(scanline, ppumask >> 5);
+    }
+}
+
+template<uint8_t MASK>
+void PPU::renderPixelMasked() {
+    constexpr bool grayscale = MASK & 0x01;
+    constexpr bool bgLeft = MASK & 0x02;
+    constexpr bool sprLeft = MASK & 0x04;
+    constexpr bool bgVisible = MASK & 0x08;
+    constexpr bool sprVisible = MASK & 0x10;
+
     uint8_t bgPixel = 0;
     uint8_t bgPalette = 0;
     bool bgOpaque = false;
     int x = cycle - 1;
     
-    // 1. Background Pixel
-    bool bgVisible = (ppumask & 0x08);
-    if (bgVisible) {
-        // Handle background clipping (bit 1 of $2001)
-        if (x >= 8 || (ppumask & 0x02)) {
-            // Bit selection based on fineX
-            uint16_t mask = 0x8000 >> fineX;
-            
-            uint8_t p0 = (bgShiftPatternLo & mask) ? 1 : 0;
-            uint8_t p1 = (bgShiftPatternHi & mask) ? 1 : 0;
-            bgPixel = (p1 << 1) | p0;
-            
-            uint8_t a0 = (bgShiftAttrLo & mask) ? 1 : 0;
-            uint8_t a1 = (bgShiftAttrHi & mask) ? 1 : 0;
-            bgPalette = (a1 << 1) | a0;
-            
-            bgOpaque = (bgPixel != 0);
-        }
+    // 1. Background Pixel (bit 1 of $2001 unclips the left column)
+    if (bgVisible && (bgLeft || x >= 8)) {
+        // Pixel selection based on fineX
+        int shift = 30 - 2 * fineX;
+        bgPixel = (bgShiftPixels >> shift) & 3;
+        bgPalette = (bgShiftPalettes >> shift) & 3;
+        
+        bgOpaque = (bgPixel != 0);
     }
     
     // 2. Sprite Pixel
@@ -383,46 +953,21 @@ void PPU::renderPixel() {
     bool sprOpaque = false;
     bool isSprite0 = false;
     
-    bool sprVisible = (ppumask & 0x10);
-    if (sprVisible) {
-        // Handle sprite clipping (bit 2 of $2001)
-        if (x >= 8 || (ppumask & 0x04)) {
-            // Iterate front-to-back because we want the first sprite that matches
-            for (int i = 0; i < spriteCount; i++) {
-                int idx = i * 4;
-                int sa = secondaryOAM[idx + 2];
-                int sx = secondaryOAM[idx + 3];
-                
-                if (x >= sx && x < sx + 8) {
-                    uint8_t p0 = spriteFetchedLo[i];
-                    uint8_t p1 = spriteFetchedHi[i];
-                    
-                    int col = x - sx;
-                    if (sa & 0x40) col = 7 - col;
-                    
-                    uint8_t bit0 = (p0 >> (7 - col)) & 1;
-                    uint8_t bit1 = (p1 >> (7 - col)) & 1;
-                    uint8_t pixel = (bit1 << 1) | bit0;
-                    
-                    if (pixel != 0) {
-                        sprPixel = pixel;
-                        sprPalette = (sa & 0x03) + 4;
-                        sprPriority = (sa & 0x20);
-                        sprOpaque = true;
-                        if (i == 0 && sprite0InSecondary) isSprite0 = true;
-                        break;
-                    }
-                }
-            }
+    // Bit 2 of $2001 unclips the left column
+    if (sprVisible && (sprLeft || x >= 8)) {
+        uint8_t entry = spriteLine[x];
+        if (entry & SPRITE_PIXEL) {
+            sprPixel = entry & SPRITE_PIXEL;
+            sprPalette = ((entry & SPRITE_PALETTE) >> 2) + 4;
+            sprPriority = (entry & SPRITE_BEHIND);
+            sprOpaque = true;
+            isSprite0 = (entry & SPRITE_SLOT0) && sprite0InSecondary;
         }
     }
     
-    // 3. Sprite 0 Hit
+    // 3. Sprite 0 Hit (both layers enabled: only then can both be opaque)
     if (isSprite0 && bgOpaque && sprOpaque && x < 255) {
-        // Double check rendering enabled for both
-        if ((ppumask & 0x18) == 0x18) {
-             ppustatus |= 0x40;
-        }
+        raiseStatus(0x40, scanline, cycle);
     }
     
     // 4. Multiplexing
@@ -450,13 +995,22 @@ void PPU::renderPixel() {
     if (finalPixel == 0) paletteIndex = paletteTable[0]; // Global background color
     
     // Apply Grayscale
-    if (ppumask & 0x01) paletteIndex &= 0x30;
+    if (grayscale) paletteIndex &= 0x30;
     
-    // Write to buffer
-    if (pixelBuffer) {
-        int index = scanline * SCREEN_WIDTH + (cycle - 1);
-        if (index >= 0 && index < SCREEN_WIDTH * SCREEN_HEIGHT) {
-            pixelBuffer[index] = nesPalette[paletteIndex & 0x3F];
-        }
+    // Write to buffer (the line keeps the emphasis of its last pixel)
+    if (frames && scanline < SCREEN_HEIGHT && x >= 0 && x < SCREEN_WIDTH) {
+        frames->row(scanline, false)[x] = paletteIndex & 0x3F;
+        frames->setEmphasis(scanline, ppumask >> 5);
     }
 }
+
+void PPU::selectPixelKernel() {
+#define PIXEL_KERNELS(m) &PPU::renderPixelMasked<m>, &PPU::renderPixelMasked<m + 1>, \
+                         &PPU::renderPixelMasked<m + 2>, &PPU::renderPixelMasked<m + 3>
+    static const PixelFn kernels[32] = {
+        PIXEL_KERNELS(0),  PIXEL_KERNELS(4),  PIXEL_KERNELS(8),  PIXEL_KERNELS(12),
+        PIXEL_KERNELS(16), PIXEL_KERNELS(20), PIXEL_KERNELS(24), PIXEL_KERNELS(28)
+    };
+#undef PIXEL_KERNELS
+    pixelKernel = kernels[ppumask & 0x1F];
+}
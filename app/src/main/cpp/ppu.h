@@ -2,12 +2,21 @@
  * PPU (Picture Processing Unit) Module
  * Responsibility: Rendering, VRAM management, and Frame timing.
  * Features: Cycle-accurate background fetching and Optimized sprite pre-fetching.
+ * Whole lines render in one pass unless a register access splits them.
  */
 
 #ifndef PPU_H
 #define PPU_H
 
 #include <cstdint>
+#include <memory>
+#include "scheduler.h"
+#include "memory_map.h"
+#include "chr_cache.h"
+#include "nametable_cache.h"
+#include "video_output.h"
+
+struct PpuWriteLog;
 
 struct Sprite {
     uint8_t y;
@@ -19,15 +28,33 @@ struct Sprite {
 struct PPU {
     uint8_t paletteTable[32];
     Sprite sprites[64];  // Primary OAM
-    uint32_t* pixelBuffer = nullptr; // For cycle-accurate rendering
+    FrameQueue* frames = nullptr; // Palette indices + line emphasis, published at vblank (video_output.h)
     
     // Secondary OAM (8 sprites for current scanline)
     uint8_t secondaryOAM[32];  // 8 sprites × 4 bytes
     uint8_t spriteCount = 0;   // 0-8
     
-    // Sprite Fetch Buffer (Performance)
-    uint8_t spriteFetchedLo[8];
-    uint8_t spriteFetchedHi[8];
+    // Sprite Line Buffer (Performance): the next line's sprites, rasterized at dot 257
+    // with front-to-back priority already resolved. Zero pixel bits = no sprite there.
+    enum : uint8_t {
+        SPRITE_PIXEL   = 0x03, // 2-bit pattern value
+        SPRITE_PALETTE = 0x0C, // Attribute palette (sprite palettes 4-7)
+        SPRITE_BEHIND  = 0x20, // Priority: behind background (attribute bit 5)
+        SPRITE_SLOT0   = 0x40  // From secondary OAM slot 0 (sprite 0 when sprite0InSecondary)
+    };
+    uint8_t spriteLine[256];
+
+    // Sprite Buckets: OAM indexed by the line it covers, so evaluation reads a list
+    // instead of scanning 64 entries. Stale after any OAM write ($2004, DMA) and
+    // rebuilt by the next evaluation, or when the sprite size changes.
+    struct SpriteBucket {
+        uint8_t count;    // 0-8
+        bool overflow;    // Evaluation of this line sets the overflow flag
+        uint8_t index[8]; // OAM indices, front to back
+    };
+    SpriteBucket spriteBuckets[240];
+    bool spriteBucketsValid = false;
+    int bucketHeight = 8;
     
     bool sprite0InSecondary = false;
     bool spriteOverflow = false;
@@ -35,6 +62,11 @@ struct PPU {
     // Loopy registers (v, t, x, w) are below in "Internal Registers"
 
     class Mapper* mapper = nullptr;
+    ChrTileCache* chr = nullptr;        // Pattern fetches (set by Mapper::attachPpu)
+    PpuPageTable pages;                 // Every other $0000-$3EFF read (kept by the mapper)
+    struct CPU* cpu = nullptr;          // NMI line
+    Scheduler* scheduler = nullptr;     // Posts Event::VBlank
+    uint64_t syncedCycle = 0;           // CPU cycle the PPU has been run up to
 
     // PPU Registers ($2000-$2002)
     uint8_t ppuctrl = 0;   // $2000: Control
@@ -46,7 +78,6 @@ struct PPU {
     int cycle = 0;
     bool oddFrame = false; // For skipped cycle on pre-render
     uint8_t oamAddr = 0; 
-    bool nmiOccurred = false;
     bool nmiPrevious = false; // For edge detection
 
     // Internal Registers & Latches ($2005, $2006)
@@ -56,12 +87,39 @@ struct PPU {
     bool writeToggle = false; // w
     uint8_t readBuffer = 0; 
 
+    // Static-frame elision: a frame that starts in the same render state as the last
+    // rendered frame of its parity, with no picture-affecting write since that one
+    // began, repeats it exactly. It is not drawn: the position advances, the recorded
+    // sprite 0 hit / overflow are raised on their dots, and the recorded end state and
+    // picture are restored. Writes call bumpGeneration()
+    // before changing anything the picture depends on; one landing inside an elided
+    // frame first renders it for real up to that dot.
+    bool frameElision = true;
+    uint32_t generation = 0;
+    uint32_t framesElided = 0;
+    void bumpGeneration();
+
+    // Nametable cache (optional): whole lines with the background on are copied out of
+    // pre-rendered nametables instead of fetched tile by tile. The mapper invalidates it
+    // when CHR banks or mirroring change.
+    std::unique_ptr<NametableCache> nametables;
+    void setNametableCache(bool enabled);
+
+    // Deferred rendering (deferred_ppu.h): with no output, whole lines that cannot raise
+    // sprite 0 hit are not drawn at all, and every input is appended to `writeLog`.
+    PpuWriteLog* writeLog = nullptr;
+    void setOutput(FrameQueue* target);  // Also forgets the frames recorded for elision
+    void copyState(PPU& source);         // Everything but the connections; caches start empty
+    void writeOam(const uint8_t* data);  // OAM DMA
+
     void reset();
-    void step(int cycles, struct CPU* cpu);
+    void catchUp(uint64_t cpuCycle); // Runs the dots owed since syncedCycle, then reposts VBlank
     uint8_t readRegister(uint16_t addr);
     void writeRegister(uint16_t addr, uint8_t val);
     uint8_t readStatus();
+    int dotsUntilStatusChange() const; // Idle-loop horizon (idle_loop.h)
     inline uint8_t vramRead(uint16_t addr);
+    inline uint16_t patternRow(uint16_t addr, bool flip); // Decoded CHR row at a low-plane address
     inline void vramWrite(uint16_t addr, uint8_t val);
     
     // Loopy register helpers
@@ -70,28 +128,90 @@ struct PPU {
     void copyX();
     void copyY();
     
-    // Shift Registers (Background)
-    uint16_t bgShiftPatternLo = 0;
-    uint16_t bgShiftPatternHi = 0;
-    uint16_t bgShiftAttrLo = 0;
-    uint16_t bgShiftAttrHi = 0;
+    // Shift Registers (Background): 16 pixels of 2 bits, the next one out in bits 31-30
+    uint32_t bgShiftPixels = 0;
+    uint32_t bgShiftPalettes = 0;
 
     // Latches for next tile data
     uint8_t bgNextTileId = 0;
     uint8_t bgNextTileAttr = 0;
-    uint8_t bgNextTileLo = 0;
-    uint8_t bgNextTileHi = 0;
+    uint16_t bgNextTileRow = 0; // Decoded pattern row (chr_cache.h)
     
     // Fetch Helpers
     void loadBackgroundShifters();
     void updateShifters();
     
     // Pixel Rendering
-    void renderPixel();
+    void renderPixel() { (this->*pixelKernel)(); } // Dot 1-256 of a visible line, current PPUMASK
+    void renderScanline();       // Visible line, dots 1-340 plus the wrap, in one call
+    void composeLine(uint8_t* bgLine);
+    void backgroundFromCache(uint8_t* bgLine); // renderScanline()'s dots 1-256 from `nametables`
+    void drawCachedTile(int table, int column, int row);
 
 private:
+    // Registers a frame reads (only their values while it is drawn matter), then
+    // everything drawing it changes besides PPUSTATUS, the position and the picture
+    struct RenderState {
+        uint16_t tempAddr;
+        uint8_t ppuctrl, ppumask, fineX;
+        uint32_t bgShiftPixels, bgShiftPalettes;
+        uint16_t vramAddr, bgNextTileRow;
+        uint8_t bgNextTileId, bgNextTileAttr, spriteCount;
+        bool sprite0InSecondary;
+        uint8_t secondaryOAM[32];
+        uint8_t spriteLine[256];
+    };
+    struct FrameRecord {
+        bool valid = false;      // Finished with no generation bump since it started
+        uint32_t generation = 0; // At the start
+        RenderState start, end;
+        int eventCount = 0;
+        struct { int dot; uint8_t bit; } events[2]; // Sprite 0 hit / overflow, by frameDot()
+        std::unique_ptr<IndexedFrame> picture;       // What it drew, when there is a frame queue
+    };
+    FrameRecord frameRecords[2];         // Last rendered frame of each parity (oddFrame at its start)
+    FrameRecord* recording = nullptr;    // Frame being drawn, if it can serve as a reference
+    FrameRecord* elided = nullptr;       // Reference of the frame being skipped
+    int elidedDot = -1;                  // frameDot() reached by the skipped frame
+    int frameSkipDot = 0;                // 1 when pre-render dot 340 is skipped this frame
+    bool frameOddStart = false;          // oddFrame when the frame began
+    bool replaying = false;              // resumeRendering() in progress
+
+    void runDots(int dots);
+    void beginFrame();           // At (260, 340): elide the frame, or record it
+    void endFrame();             // At (240, 0)
+    int skipElided(int maxDots); // Returns dots consumed
+    void resumeRendering();      // Redraw the elided frame up to the current dot
+    int frameDot(int line, int dot) const; // Pre-render dot 0 = 0
+    void captureState(RenderState& state) const;
+    void restoreState(const RenderState& state);
+    void raiseStatus(uint8_t bit, int line, int dot); // Sprite 0 hit / overflow
+    void changeScroll();         // Before a change to v, t, x, PPUCTRL or PPUMASK
+    void moveVramAddr(uint16_t addr);
+
+    // renderPixel() specialized on the PPUMASK bits it reads (grayscale, left-column
+    // clipping, layer enables): picked when $2001 is written, so no pixel tests them.
+    typedef void (PPU::*PixelFn)();
+    PixelFn pixelKernel = nullptr;
+    template<uint8_t MASK> void renderPixelMasked();
+    void selectPixelKernel();
+
+    void tick();                 // One dot of the full pipeline
+    int skipIdle(int maxDots);   // Bulk advance where no per-dot work happens; returns dots consumed
+    int dotsUntil(int line, int dot) const;
+    void raiseNmi();
     void processBackground();
     void processSprites();
+    void evaluateSprites();      // Dot 257: sprites of the next line
+    void buildSpriteBuckets(int spriteHeight);
+    void rasterizeSprite(int x, uint16_t pixels, uint8_t flags);
+    void fetchNametable();
+    void fetchAttribute();
+    void fetchPatternLo();
+    void fetchPatternHi();
+    void fetchPattern();
+    void fetchTile();            // All four fetches of one 8-dot slot
+    void shiftBackground(int n); // updateShifters() n times
     void handleVBlank();
 };
 
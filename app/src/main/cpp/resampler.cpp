@@ -0,0 +1,134 @@
+#include "resampler.h"
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+float firScalar(const float* input, const float* rowA, const float* rowB, float blend) {
+    float sum = 0;
+    for (int i = 0; i < Resampler::TAPS; i++) sum += input[i] * (rowA[i] + (rowB[i] - rowA[i]) * blend);
+    return sum;
+}
+
+// Four taps per step, one horizontal sum at the end
+#if defined(__SSE2__)
+float firSse2(const float* input, const float* rowA, const float* rowB, float blend) {
+    const __m128 t = _mm_set1_ps(blend);
+    __m128 sum = _mm_setzero_ps();
+    for (int i = 0; i < Resampler::TAPS; i += 4) {
+        __m128 a = _mm_load_ps(rowA + i);
+        __m128 c = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(_mm_load_ps(rowB + i), a), t));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(input + i), c));
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(sum);
+}
+#endif
+
+#if defined(__aarch64__)
+float firNeon(const float* input, const float* rowA, const float* rowB, float blend) {
+    float32x4_t sum = vdupq_n_f32(0);
+    for (int i = 0; i < Resampler::TAPS; i += 4) {
+        float32x4_t a = vld1q_f32(rowA + i);
+        float32x4_t c = vmlaq_n_f32(a, vsubq_f32(vld1q_f32(rowB + i), a), blend);
+        sum = vmlaq_f32(sum, vld1q_f32(input + i), c);
+    }
+    return vaddvq_f32(sum);
+}
+#endif
+
+} // namespace
+
+const KernelTable<ResamplerKernel, FirFn>& resamplerKernels() {
+    static const KernelEntry<ResamplerKernel, FirFn> list[] = {
+        {ResamplerKernel::Neon, "NEON", NEON_KERNEL(firNeon)},
+        {ResamplerKernel::Sse2, "SSE2", SSE2_KERNEL(firSse2)},
+        {ResamplerKernel::Scalar, "scalar", firScalar},
+    };
+    static const KernelTable<ResamplerKernel, FirFn> table(list);
+    return table;
+}
+
+Resampler::Resampler() {
+    setRates(1.0, 1.0);
+    reset();
+}
+
+// Blackman-windowed sinc at `cutoff` (of the input Nyquist), each row normalized to
+// unity gain so a constant input comes out unchanged.
+void Resampler::buildRows(double cutoff) {
+    const double pi = 3.14159265358979323846;
+    const int half = TAPS / 2;
+    for (int p = 0; p <= PHASES; p++) {
+        double taps[TAPS];
+        double sum = 0;
+        for (int i = 0; i < TAPS; i++) {
+            double x = (i - (half - 1)) - (double)p / PHASES; // Input samples from the position
+            double w = (x + half) / TAPS;                     // 0..1 across the window
+            double window = 0.42 - 0.5 * cos(2 * pi * w) + 0.08 * cos(4 * pi * w);
+            double sinc = x == 0 ? 1.0 : sin(pi * cutoff * x) / (pi * cutoff * x);
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+        for (int i = 0; i < TAPS; i++) rows[p][i] = (float)(taps[i] / sum);
+    }
+}
+
+void Resampler::setRates(double inputRate, double outputRate) {
+    if (inputRate == inRate && outputRate == outRate) return;
+    inRate = inputRate;
+    outRate = outputRate;
+    nominalStep = inputRate / outputRate;
+    // Below the output's Nyquist when downsampling, with room for the window's transition band
+    buildRows(0.9 * (outputRate < inputRate ? outputRate / inputRate : 1.0));
+    setAdjust(1.0);
+}
+
+void Resampler::setAdjust(double ratio) {
+    step = (uint64_t)llround(nominalStep / ratio * (double)(1ULL << FRAC_BITS));
+}
+
+void Resampler::reset() {
+    memset(history, 0, sizeof(history));
+    queued = TAPS / 2 - 1; // Silence before the first sample: output 0 lands on input 0
+    position = 0;
+}
+
+void Resampler::write(const float* in, int count) {
+    int room = TAPS + MAX_INPUT - queued;
+    if (count > room) count = room;
+    memcpy(history + queued, in, count * sizeof(float));
+    queued += count;
+}
+
+int Resampler::read(float* out, int maxCount) {
+    static const FirFn fir = resamplerKernels().bestFn();
+    const uint64_t fracMask = (1ULL << FRAC_BITS) - 1;
+    const float blendScale = 1.0f / (float)(1ULL << (FRAC_BITS - PHASE_BITS));
+    int count = 0;
+    while (count < maxCount) {
+        uint64_t index = position >> FRAC_BITS;
+        if (index + TAPS > (uint64_t)queued) break;
+        uint32_t frac = (uint32_t)(position & fracMask);
+        int phase = frac >> (FRAC_BITS - PHASE_BITS);
+        float blend = (frac & ((1u << (FRAC_BITS - PHASE_BITS)) - 1)) * blendScale;
+        out[count++] = fir(history + index, rows[phase], rows[phase + 1], blend);
+        position += step;
+    }
+
+    // Drop the input no output needs any more
+    int consumed = (int)(position >> FRAC_BITS);
+    if (consumed > queued) consumed = queued;
+    memmove(history, history + consumed, (queued - consumed) * sizeof(float));
+    queued -= consumed;
+    position -= (uint64_t)consumed << FRAC_BITS;
+    return count;
+}
@@ -0,0 +1,59 @@
+/*
+ * Resampler Module
+ * Responsibility: Take the APU's output from its fixed internal rate to the device's
+ * native rate, so the OS does not resample it a second time.
+ * A polyphase windowed-sinc FIR: PHASES + 1 rows of TAPS coefficients, with the two
+ * rows either side of the fractional position blended. The cutoff follows the
+ * nominal ratio; the step can be trimmed by small ratios at any time (drift control)
+ * without rebuilding the rows. The SSE2 and NEON dot products sum in a different
+ * order from the scalar one, so they agree with it to float rounding.
+ */
+
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <cstdint>
+#include "kernel_dispatch.h"
+
+enum class ResamplerKernel : uint8_t { Scalar, Sse2, Neon, Count };
+
+// One output: `input` holds TAPS samples, rows a and b are blended by `blend` (0-1)
+typedef float (*FirFn)(const float* input, const float* rowA, const float* rowB, float blend);
+
+const KernelTable<ResamplerKernel, FirFn>& resamplerKernels();
+
+class Resampler {
+public:
+    static constexpr int TAPS = 16;
+    static constexpr int PHASE_BITS = 6;
+    static constexpr int PHASES = 1 << PHASE_BITS;
+    static constexpr int MAX_INPUT = 4096; // Input samples queued between reads
+    static constexpr int FRAC_BITS = 32;   // Fraction bits of the input position
+
+    Resampler();
+
+    // Rebuilds the rows when the nominal ratio changes; the queued input is kept.
+    void setRates(double inputRate, double outputRate);
+    // Output rate times `ratio` from the next sample on
+    void setAdjust(double ratio);
+    void reset();
+
+    // Queues input; anything past MAX_INPUT is dropped (read in between).
+    void write(const float* in, int count);
+    // Outputs the queued input covers (each needs TAPS / 2 input samples past it).
+    int read(float* out, int maxCount);
+
+private:
+    alignas(16) float rows[PHASES + 1][TAPS];
+    float history[TAPS + MAX_INPUT];
+    int queued = 0;
+    uint64_t position = 0;  // In `history`, FRAC_BITS fraction
+    uint64_t step = 0;
+    double nominalStep = 1;
+    double inRate = 0;
+    double outRate = 0;
+
+    void buildRows(double cutoff);
+};
+
+#endif
@@ -0,0 +1,45 @@
+/*
+ * Scheduler Module
+ * Responsibility: Master timeline in CPU cycles (CPU::totalCycles).
+ * Components post the timestamp of their next externally visible event; the frame
+ * loop runs the CPU straight up to the earliest one, lets the owner catch up
+ * (which raises the interrupt line and posts the following event) and carries on.
+ * Posting early is harmless: the owner finds nothing due yet and posts again.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <cstdint>
+
+enum class Event : uint8_t {
+    FrameEnd,   // Frame loop hands the finished frame to Java
+    VBlank,     // PPU reaches scanline 241, dot 1 (NMI)
+    FrameIrq,   // APU frame counter raises its IRQ
+    Count
+};
+
+struct Scheduler {
+    static constexpr uint64_t NEVER = UINT64_MAX;
+
+    uint64_t at[(int)Event::Count];
+    uint64_t next = NEVER; // Earliest of at[]
+
+    Scheduler() { reset(); }
+
+    void reset() {
+        for (uint64_t& t : at) t = NEVER;
+        next = NEVER;
+    }
+
+    void schedule(Event e, uint64_t when) {
+        at[(int)e] = when;
+        next = NEVER;
+        for (uint64_t t : at) if (t < next) next = t;
+    }
+
+    void cancel(Event e) { schedule(e, NEVER); }
+    bool due(Event e, uint64_t now) const { return at[(int)e] <= now; }
+};
+
+#endif
@@ -0,0 +1,224 @@
+#include "video_output.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+void convertScalar(const uint8_t* pixels, const uint32_t* colors, uint32_t* out, int count) {
+    for (int x = 0; x < count; x++) out[x] = colors[pixels[x]];
+}
+
+void convert16Scalar(const uint8_t* pixels, const uint16_t* colors, uint16_t* out, int count) {
+    for (int x = 0; x < count; x++) out[x] = colors[pixels[x]];
+}
+
+#if defined(__x86_64__)
+// 8 pixels per gather.
+__attribute__((target("avx2")))
+void convertAvx2(const uint8_t* pixels, const uint32_t* colors, uint32_t* out, int count) {
+    int x = 0;
+    for (; x + 8 <= count; x += 8) {
+        __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(pixels + x)));
+        _mm256_storeu_si256((__m256i*)(out + x), _mm256_i32gather_epi32((const int*)colors, idx, 4));
+    }
+    convertScalar(pixels + x, colors, out + x, count - x);
+}
+
+// 16 pixels per step: two 8-wide gathers of 32-bit words (the entry plus its neighbour),
+// the neighbour masked off and the pair packed down to 16 bits.
+__attribute__((target("avx2")))
+void convert16Avx2(const uint8_t* pixels, const uint16_t* colors, uint16_t* out, int count) {
+    const __m256i lowHalf = _mm256_set1_epi32(0xFFFF);
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        __m256i idxLo = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(pixels + x)));
+        __m256i idxHi = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(pixels + x + 8)));
+        __m256i lo = _mm256_and_si256(_mm256_i32gather_epi32((const int*)colors, idxLo, 2), lowHalf);
+        __m256i hi = _mm256_and_si256(_mm256_i32gather_epi32((const int*)colors, idxHi, 2), lowHalf);
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(lo, hi), 0xD8); // Undo the lane split
+        _mm256_storeu_si256((__m256i*)(out + x), packed);
+    }
+    convert16Scalar(pixels + x, colors, out + x, count - x);
+}
+#endif
+
+#if defined(__aarch64__)
+// 16 pixels per step: one 64-byte table lookup per output byte, re-interleaved by vst4.
+void convertNeon(const uint8_t* pixels, const uint32_t* colors, uint32_t* out, int count) {
+    uint8_t planes[4][64];
+    for (int i = 0; i < 64; i++) {
+        for (int k = 0; k < 4; k++) planes[k][i] = (uint8_t)(colors[i] >> (8 * k));
+    }
+    uint8x16x4_t table[4];
+    for (int k = 0; k < 4; k++) {
+        for (int q = 0; q < 4; q++) table[k].val[q] = vld1q_u8(planes[k] + 16 * q);
+    }
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        uint8x16_t idx = vld1q_u8(pixels + x);
+        uint8x16x4_t rgba;
+        for (int k = 0; k < 4; k++) rgba.val[k] = vqtbl4q_u8(table[k], idx);
+        vst4q_u8((uint8_t*)(out + x), rgba);
+    }
+    convertScalar(pixels + x, colors, out + x, count - x);
+}
+
+// Same with two byte planes, re-interleaved by vst2.
+void convert16Neon(const uint8_t* pixels, const uint16_t* colors, uint16_t* out, int count) {
+    uint8_t planes[2][64];
+    for (int i = 0; i < 64; i++) {
+        planes[0][i] = (uint8_t)colors[i];
+        planes[1][i] = (uint8_t)(colors[i] >> 8);
+    }
+    uint8x16x4_t table[2];
+    for (int k = 0; k < 2; k++) {
+        for (int q = 0; q < 4; q++) table[k].val[q] = vld1q_u8(planes[k] + 16 * q);
+    }
+    int x = 0;
+    for (; x + 16 <= count; x += 16) {
+        uint8x16_t idx = vld1q_u8(pixels + x);
+        uint8x16x2_t halves;
+        for (int k = 0; k < 2; k++) halves.val[k] = vqtbl4q_u8(table[k], idx);
+        vst2q_u8((uint8_t*)(out + x), halves);
+    }
+    convert16Scalar(pixels + x, colors, out + x, count - x);
+}
+#endif
+
+} // namespace
+
+// --- Frame queue ---
+
+FrameQueue::FrameQueue() : ready(2), publishCount(0) {
+    memset(rowReady, 0, sizeof(rowReady));
+}
+
+void FrameQueue::prepareRow(int y, bool whole) {
+    IndexedFrame& back = slots[backSlot];
+    if (!whole && lastPublished >= 0) {
+        // The consumer may be reading this slot too, but nobody writes it until the
+        // producer gets it back, after its next publish().
+        const IndexedFrame& last = slots[lastPublished];
+        memcpy(back.pixels + y * IndexedFrame::WIDTH, last.pixels + y * IndexedFrame::WIDTH, IndexedFrame::WIDTH);
+        back.emphasis[y] = last.emphasis[y];
+    }
+    rowReady[y] = true;
+}
+
+void FrameQueue::publish() {
+    IndexedFrame& back = slots[backSlot];
+    uint64_t changed[4] = {};
+    for (int y = 0; y < IndexedFrame::HEIGHT; y++) {
+        if (!rowReady[y]) {
+            prepareRow(y, false); // Carried over: unchanged
+            continue;
+        }
+        bool dirty = true;
+        if (lastPublished >= 0) {
+            const IndexedFrame& last = slots[lastPublished];
+            int offset = y * IndexedFrame::WIDTH;
+            dirty = back.emphasis[y] != last.emphasis[y] ||
+                    memcmp(back.pixels + offset, last.pixels + offset, IndexedFrame::WIDTH) != 0;
+        }
+        if (dirty) changed[y >> 6] |= 1ull << (y & 63);
+    }
+    back.sequence = publishCount.load(std::memory_order_relaxed) + 1;
+
+    // If the slot in transit was never acquired it is dropped, and its dirty rows carry
+    // into this frame. The consumer may take it meanwhile, hence the retry.
+    uint8_t pending = ready.load(std::memory_order_acquire);
+    for (;;) {
+        memcpy(back.dirtyRows, changed, sizeof(changed));
+        if (pending & FRESH) {
+            const IndexedFrame& dropped = slots[pending & ~FRESH];
+            for (int i = 0; i < 4; i++) back.dirtyRows[i] |= dropped.dirtyRows[i];
+        }
+        if (ready.compare_exchange_weak(pending, (uint8_t)(backSlot | FRESH),
+                                        std::memory_order_acq_rel, std::memory_order_acquire)) break;
+    }
+    lastPublished = backSlot;
+    backSlot = pending & ~FRESH;
+    memset(rowReady, 0, sizeof(rowReady));
+    publishCount.fetch_add(1, std::memory_order_release);
+}
+
+bool FrameQueue::copyBack(IndexedFrame& picture) const {
+    for (int y = 0; y < IndexedFrame::HEIGHT; y++) {
+        if (!rowReady[y]) return false;
+    }
+    const IndexedFrame& back = slots[backSlot];
+    memcpy(picture.pixels, back.pixels, sizeof(back.pixels));
+    memcpy(picture.emphasis, back.emphasis, sizeof(back.emphasis));
+    return true;
+}
+
+void FrameQueue::fillBack(const IndexedFrame& picture) {
+    IndexedFrame& back = slots[backSlot];
+    memcpy(back.pixels, picture.pixels, sizeof(back.pixels));
+    memcpy(back.emphasis, picture.emphasis, sizeof(back.emphasis));
+    memset(rowReady, 1, sizeof(rowReady));
+}
+
+const IndexedFrame& FrameQueue::acquire() {
+    if (ready.load(std::memory_order_relaxed) & FRESH) {
+        frontSlot = ready.exchange((uint8_t)frontSlot, std::memory_order_acq_rel) & ~FRESH;
+    }
+    return slots[frontSlot];
+}
+
+// --- Conversion ---
+
+const KernelTable<ConvertKernel, ConvertFn>& convertKernels() {
+    static const KernelEntry<ConvertKernel, ConvertFn> list[] = {
+        {ConvertKernel::Neon, "NEON", NEON_KERNEL(convertNeon)},
+        {ConvertKernel::Avx2, "AVX2", AVX2_KERNEL(convertAvx2), cpuHasAvx2},
+        {ConvertKernel::Scalar, "scalar", convertScalar},
+    };
+    static const KernelTable<ConvertKernel, ConvertFn> table(list);
+    return table;
+}
+
+const KernelTable<ConvertKernel, Convert16Fn>& convert16Kernels() {
+    static const KernelEntry<ConvertKernel, Convert16Fn> list[] = {
+        {ConvertKernel::Neon, "NEON", NEON_KERNEL(convert16Neon)},
+        {ConvertKernel::Avx2, "AVX2", AVX2_KERNEL(convert16Avx2), cpuHasAvx2},
+        {ConvertKernel::Scalar, "scalar", convert16Scalar},
+    };
+    static const KernelTable<ConvertKernel, Convert16Fn> table(list);
+    return table;
+}
+
+namespace {
+
+void convertRow(const IndexedFrame& frame, const DisplayPalette& palette, void* out, int y) {
+    static const ConvertFn kernel = convertKernels().bestFn();
+    static const Convert16Fn kernel16 = convert16Kernels().get(convertKernels().best());
+    const uint8_t* line = frame.pixels + y * IndexedFrame::WIDTH;
+    int base = (frame.emphasis[y] & 0x07) * 64;
+    if (palette.format == PixelFormat::RGB565) {
+        kernel16(line, palette.colors16 + base, (uint16_t*)out + y * IndexedFrame::WIDTH, IndexedFrame::WIDTH);
+    } else {
+        kernel(line, palette.colors + base, (uint32_t*)out + y * IndexedFrame::WIDTH, IndexedFrame::WIDTH);
+    }
+}
+
+} // namespace
+
+void convertFrame(const IndexedFrame& frame, const DisplayPalette& palette, void* out) {
+    for (int y = 0; y < IndexedFrame::HEIGHT; y++) convertRow(frame, palette, out, y);
+}
+
+int convertDirtyRows(const IndexedFrame& frame, const DisplayPalette& palette, void* out) {
+    int rows = 0;
+    for (int y = 0; y < IndexedFrame::HEIGHT; y++) {
+        if (!frame.rowDirty(y)) continue;
+        convertRow(frame, palette, out, y);
+        rows++;
+    }
+    return rows;
+}
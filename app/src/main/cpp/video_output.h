@@ -0,0 +1,109 @@
+/*
+ * Video Output Module
+ * Responsibility: The PPU's indexed frame and its conversion to display pixels.
+ * The PPU writes one byte per pixel (system palette index) and the emphasis bits of
+ * each line; turning that into a pixel format is a separate pass through a 512-entry
+ * (emphasis x index) color table, run by whichever thread presents the frame.
+ * Finished frames pass from the emulation thread to the presenting one through a
+ * lock-free triple buffer (FrameQueue).
+ */
+
+#ifndef VIDEO_OUTPUT_H
+#define VIDEO_OUTPUT_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include "kernel_dispatch.h"
+#include "palette.h"
+
+struct IndexedFrame {
+    static constexpr int WIDTH = 256;
+    static constexpr int HEIGHT = 240;
+
+    uint8_t pixels[WIDTH * HEIGHT]; // System palette index, always 0-63 (kernels do not mask)
+    uint8_t emphasis[HEIGHT];       // $2001 bits 5-7 (shifted down) as the line was drawn
+
+    // Set by FrameQueue::publish(): the frame's number (from 1), and the rows that differ
+    // from the frame the consumer acquired before this one.
+    uint32_t sequence;
+    uint64_t dirtyRows[4];
+
+    IndexedFrame() { clear(); }
+    void clear() { // Black until the PPU draws over it
+        memset(pixels, 0x0F, sizeof(pixels));
+        memset(emphasis, 0, sizeof(emphasis));
+        sequence = 0;
+        memset(dirtyRows, 0xFF, sizeof(dirtyRows));
+    }
+    bool rowDirty(int y) const { return (dirtyRows[y >> 6] >> (y & 63)) & 1; }
+};
+
+// Triple buffer: the producer (PPU) draws into its back slot and publishes it at
+// vblank; the consumer takes the latest published slot whenever it presents. The
+// third slot is exchanged atomically between them, so neither side waits or copies
+// and a frame is never read while it is being drawn.
+class FrameQueue {
+public:
+    static constexpr int SLOTS = 3;
+
+    FrameQueue();
+
+    // --- Producer (emulation thread) ---
+    // Row y of the back frame, about to be written. Rows not written before publish()
+    // keep the last published contents (the PPU draws nothing while rendering is off);
+    // `whole` says all 256 pixels will be overwritten, so nothing needs carrying over.
+    uint8_t* row(int y, bool whole) {
+        if (!rowReady[y]) prepareRow(y, whole);
+        return slots[backSlot].pixels + y * IndexedFrame::WIDTH;
+    }
+    void setEmphasis(int y, uint8_t emphasis) { slots[backSlot].emphasis[y] = emphasis; }
+    // Hands the back frame over and starts a new one. Drawn rows are compared with the
+    // last published frame; rows of frames replaced before the consumer saw them stay
+    // dirty in the next one.
+    void publish();
+
+    // Copy of the back frame, if every row of it has been drawn since the last publish
+    bool copyBack(IndexedFrame& picture) const;
+    // Every row of the back frame from `picture`
+    void fillBack(const IndexedFrame& picture);
+
+    // --- Consumer (any one thread) ---
+    // The most recently published frame; the previous one again if nothing new was
+    // published. Stays valid and unchanged until the next acquire().
+    const IndexedFrame& acquire();
+    uint32_t published() const { return publishCount.load(std::memory_order_acquire); }
+
+private:
+    static constexpr uint8_t FRESH = 0x80; // In `ready`: published but not yet acquired
+
+    void prepareRow(int y, bool whole);
+
+    IndexedFrame slots[SLOTS];
+    std::atomic<uint8_t> ready;          // Slot in transit, plus FRESH
+    std::atomic<uint32_t> publishCount;
+    int backSlot = 0;                    // Producer's
+    int lastPublished = -1;              // Producer's: the source for carried-over rows
+    bool rowReady[IndexedFrame::HEIGHT]; // Producer's: row y of the back frame is current
+    int frontSlot = 1;                   // Consumer's
+};
+
+enum class ConvertKernel : uint8_t { Scalar, Avx2, Neon, Count };
+
+// One line: out[x] = colors[pixels[x]], `colors` being the 64 entries of one emphasis setting.
+typedef void (*ConvertFn)(const uint8_t* pixels, const uint32_t* colors, uint32_t* out, int count);
+typedef void (*Convert16Fn)(const uint8_t* pixels, const uint16_t* colors, uint16_t* out, int count);
+
+// The same kernels for both formats, so both tables pick the same one
+const KernelTable<ConvertKernel, ConvertFn>& convertKernels();
+const KernelTable<ConvertKernel, Convert16Fn>& convert16Kernels();
+
+// Whole frame into `out` (WIDTH * HEIGHT pixels of palette.bytesPerPixel()) with the
+// best kernel, in the palette's format.
+void convertFrame(const IndexedFrame& frame, const DisplayPalette& palette, void* out);
+
+// Only frame.dirtyRows. `out` must already hold the frame acquired before this one,
+// converted with the same palette (DisplayPalette::version). Returns the rows written.
+int convertDirtyRows(const IndexedFrame& frame, const DisplayPalette& palette, void* out);
+
+#endif
@@ -54,6 +54,7 @@ public class MainActivity extends Activity implements SurfaceHolder.Callback {
 
     // Audio
     private AudioTrack audioTrack;
+    private int audioRate;
     private Thread audioThread;
     private boolean audioRunning = false;
 
@@ -66,12 +67,36 @@ public class MainActivity extends Activity implements SurfaceHolder.Callback {
 
     public native void renderFrame(int[] output);
 
+    public native int renderDirtyRows(int[] output, long[] dirtyMask);
+
+    public native void setPixelFormat(int format);
+
+    public native boolean loadPalette(byte[] data);
+
     public native void setButtonState(int button, boolean pressed);
 
-    public native int getAudioSamples(byte[] out);
+    public native int getAudioSamples(short[] out);
+
+    public native void setAudioOutputRate(int rate);
 
     public native int getAudioBufferLevel();
 
+    public native void runBenchmarks();
+
+    public native void setCachedInterpreter(boolean enabled);
+
+    public native void setDynarec(boolean enabled, boolean lockstep);
+
+    public native void setIdleSkip(boolean enabled);
+
+    public native void setFrameElision(boolean enabled);
+
+    public native void setNametableCache(boolean enabled);
+
+    public native void setDeferredRendering(boolean enabled);
+
+    public native int getIdleCycles();
+
     @Override
     protected void onCreate(Bundle savedInstanceState) {
         super.onCreate(savedInstanceState);
@@ -96,22 +121,24 @@ public class MainActivity extends Activity implements SurfaceHolder.Callback {
 
         setContentView(root);
 
-        // AudioTrack Setup (8-bit PCM, Streaming)
-        int minBufSize = AudioTrack.getMinBufferSize(44100, AudioFormat.CHANNEL_OUT_MONO,
-                AudioFormat.ENCODING_PCM_8BIT);
-        audioTrack = new AudioTrack(AudioManager.STREAM_MUSIC, 44100, AudioFormat.CHANNEL_OUT_MONO,
-                AudioFormat.ENCODING_PCM_8BIT, Math.max(minBufSize, 4096), AudioTrack.MODE_STREAM);
+        // AudioTrack Setup (16-bit PCM at the device's native rate, Streaming)
+        audioRate = AudioTrack.getNativeOutputSampleRate(AudioManager.STREAM_MUSIC);
+        int minBufSize = AudioTrack.getMinBufferSize(audioRate, AudioFormat.CHANNEL_OUT_MONO,
+                AudioFormat.ENCODING_PCM_16BIT);
+        audioTrack = new AudioTrack(AudioManager.STREAM_MUSIC, audioRate, AudioFormat.CHANNEL_OUT_MONO,
+                AudioFormat.ENCODING_PCM_16BIT, Math.max(minBufSize, 8192), AudioTrack.MODE_STREAM);
         audioTrack.play();
         startAudio();
 
         screenBitmap = Bitmap.createBitmap(256, 240, Bitmap.Config.ARGB_8888);
         cpuPtr = createCpu();
+        setAudioOutputRate(audioRate);
     }
 
     private void startAudio() {
         audioRunning = true;
         audioThread = new Thread(() -> {
-            byte[] audioBuf = new byte[512];
+            short[] audioBuf = new short[512];
             boolean warmedUp = false;
             while (audioRunning) {
                 if (isPaused || !isRunning) {